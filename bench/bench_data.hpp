@@ -0,0 +1,138 @@
+#ifndef BENCHDATA_H_
+#define BENCHDATA_H_
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fst {
+
+namespace bench {
+
+static const uint64_t kNumIntKeys = 1 << 20;
+static const uint64_t kNumEmailKeys = 1 << 19;
+static const uint64_t kNumProbes = 1 << 16;  // power of two
+static const uint64_t kSeed = 2023;
+static const char *kWordsPath = "words.txt";
+
+// Synthetic and file based key sets, generated once per process.
+// All key sets are sorted and free of duplicates; string key sets are
+// prefix-free as well, as required by FSTBuilder.
+
+template <typename T>
+void sortUnique(std::vector<T> &keys) {
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+// drops every key that is a prefix of its successor
+inline void sortPrefixFree(std::vector<std::string> &keys) {
+  sortUnique(keys);
+  size_t num_keys = 0;
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (i + 1 < keys.size() && keys[i + 1].compare(0, keys[i].size(), keys[i]) == 0) continue;
+    if (num_keys != i) keys[num_keys] = std::move(keys[i]);
+    num_keys++;
+  }
+  keys.resize(num_keys);
+}
+
+template <typename T>
+const std::vector<T> &intKeys() {
+  static const std::vector<T> keys = [] {
+    std::mt19937_64 gen(kSeed);
+    std::vector<T> keys;
+    keys.reserve(kNumIntKeys);
+    for (uint64_t i = 0; i < kNumIntKeys; i++) keys.emplace_back(static_cast<T>(gen()));
+    sortUnique(keys);
+    return keys;
+  }();
+  return keys;
+}
+
+// reversed-domain emails as in the SuRF email workload, e.g. com.gmail@alice
+inline const std::vector<std::string> &emailKeys() {
+  static const std::vector<std::string> keys = [] {
+    static const char *kDomains[] = {"com.gmail", "com.yahoo", "com.hotmail", "com.outlook", "org.apache",
+                                     "edu.cmu",   "edu.mit",   "de.web",      "net.comcast", "com.aol"};
+    std::mt19937_64 gen(kSeed);
+    std::vector<std::string> keys;
+    keys.reserve(kNumEmailKeys);
+    for (uint64_t i = 0; i < kNumEmailKeys; i++) {
+      std::string key = kDomains[gen() % (sizeof(kDomains) / sizeof(kDomains[0]))];
+      key += '@';
+      const unsigned user_length = 4 + gen() % 12;
+      for (unsigned j = 0; j < user_length; j++) key += static_cast<char>('a' + gen() % 26);
+      keys.emplace_back(key);
+    }
+    sortPrefixFree(keys);
+    return keys;
+  }();
+  return keys;
+}
+
+// URLs with a skewed host distribution and wide path levels,
+// e.g. https://www.qzkf.com/a8Rk2
+inline const std::vector<std::string> &urlKeys() {
+  static const std::vector<std::string> keys = [] {
+    static const char kPathChars[] =
+        "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz-_";
+    std::mt19937_64 gen(kSeed);
+    std::vector<std::string> hosts;
+    for (unsigned i = 0; i < 50; i++) {
+      std::string host = "https://www.";
+      const unsigned host_length = 3 + gen() % 8;
+      for (unsigned j = 0; j < host_length; j++) host += static_cast<char>('a' + gen() % 26);
+      hosts.emplace_back(host + ".com/");
+    }
+    std::vector<std::string> keys;
+    keys.reserve(kNumEmailKeys);
+    for (uint64_t i = 0; i < kNumEmailKeys; i++) {
+      // the smaller of two draws favours the first hosts
+      std::string key = hosts[std::min(gen() % hosts.size(), gen() % hosts.size())];
+      const unsigned path_length = 4 + gen() % 12;
+      for (unsigned j = 0; j < path_length; j++) key += kPathChars[gen() % 64];
+      keys.emplace_back(key);
+    }
+    sortPrefixFree(keys);
+    return keys;
+  }();
+  return keys;
+}
+
+// test/words.txt, copied next to the benchmark binaries; empty if missing
+inline const std::vector<std::string> &wordKeys() {
+  static const std::vector<std::string> keys = [] {
+    std::vector<std::string> keys;
+    std::ifstream infile(kWordsPath);
+    std::string key;
+    while (infile >> key) keys.emplace_back(key);
+    sortPrefixFree(keys);
+    return keys;
+  }();
+  return keys;
+}
+
+inline std::vector<uint64_t> sequentialValues(size_t n) {
+  std::vector<uint64_t> values(n);
+  for (size_t i = 0; i < n; i++) values[i] = i;
+  return values;
+}
+
+// kNumProbes keys drawn uniformly from keys
+template <typename T>
+std::vector<T> probeKeys(const std::vector<T> &keys) {
+  std::mt19937_64 gen(kSeed + 1);
+  std::vector<T> probes;
+  probes.reserve(kNumProbes);
+  for (uint64_t i = 0; i < kNumProbes; i++) probes.emplace_back(keys[gen() % keys.size()]);
+  return probes;
+}
+
+}  // namespace bench
+
+}  // namespace fst
+
+#endif  // BENCHDATA_H_
@@ -0,0 +1,449 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_data.hpp"
+#include "fst.hpp"
+#include "int_fst.hpp"
+
+namespace fst {
+
+namespace bench {
+
+static const std::vector<std::string> &stringKeys(const std::string &dataset) {
+  if (dataset == "words") return wordKeys();
+  return emailKeys();
+}
+
+// one FST per string dataset, built on first use
+static const FST &stringFst(const std::string &dataset) {
+  static const FST words(wordKeys(), sequentialValues(wordKeys().size()));
+  static const FST emails(emailKeys(), sequentialValues(emailKeys().size()));
+  if (dataset == "words") return words;
+  return emails;
+}
+
+template <typename T>
+static const FST &intFst() {
+  static const FST fst(intKeys<T>(), sequentialValues(intKeys<T>().size()));
+  return fst;
+}
+
+template <typename T>
+static const IntFST<T> &typedIntFst() {
+  static const IntFST<T> fst(intKeys<T>(), sequentialValues(intKeys<T>().size()));
+  return fst;
+}
+
+static void BM_LookupString(benchmark::State &state, const std::string &dataset) {
+  if (stringKeys(dataset).empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  const FST &fst = stringFst(dataset);
+  const auto probes = probeKeys(stringKeys(dataset));
+  uint64_t i = 0;
+  uint64_t value = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fst.lookupKey(probes[i++ & (kNumProbes - 1)], value));
+  }
+  benchmark::DoNotOptimize(value);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_LookupString, words, std::string("words"));
+BENCHMARK_CAPTURE(BM_LookupString, emails, std::string("emails"));
+
+// the cutoff of CutoffPolicy::kSizeRatio against kLookupCost
+static void BM_LookupCutoffPolicy(benchmark::State &state, const std::string &dataset) {
+  const std::vector<std::string> &keys = dataset == "urls" ? urlKeys() : stringKeys(dataset);
+  if (keys.empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  FSTBuilder builder(kIncludeDense, kSparseDenseRatio);
+  builder.setCutoffPolicy(static_cast<CutoffPolicy>(state.range(0)));
+  builder.build(keys, sequentialValues(keys.size()));
+  const FST fst(builder);
+  const auto probes = probeKeys(keys);
+  uint64_t i = 0;
+  uint64_t value = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fst.lookupKey(probes[i++ & (kNumProbes - 1)], value));
+  }
+  benchmark::DoNotOptimize(value);
+  state.SetItemsProcessed(state.iterations());
+  state.counters["sparse_start_level"] = builder.getSparseStartLevel();
+  state.counters["bytes"] = fst.getMemoryUsage();
+}
+BENCHMARK_CAPTURE(BM_LookupCutoffPolicy, words, std::string("words"))->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_LookupCutoffPolicy, emails, std::string("emails"))->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_LookupCutoffPolicy, urls, std::string("urls"))->Arg(0)->Arg(1);
+
+static void BM_LookupStringBatched(benchmark::State &state, const std::string &dataset) {
+  if (stringKeys(dataset).empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  const FST &fst = stringFst(dataset);
+  const auto probes = probeKeys(stringKeys(dataset));
+  std::vector<uint64_t> values(kNumProbes);
+  std::unique_ptr<bool[]> found(new bool[kNumProbes]);
+  for (auto _ : state) {
+    fst.lookupKeys(probes.data(), kNumProbes, values.data(), found.get());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * kNumProbes);
+}
+BENCHMARK_CAPTURE(BM_LookupStringBatched, words, std::string("words"));
+BENCHMARK_CAPTURE(BM_LookupStringBatched, emails, std::string("emails"));
+
+// lookups handed off by an upper index that resolved the domain, i.e. the
+// first kHandOffLevel bytes: with the (level, node number) pair of the
+// hybrid trie or with a Cursor
+static void BM_HandOffLookup(benchmark::State &state, const bool use_cursor) {
+  static const size_t kHandOffLevel = 8;
+  const FST &fst = stringFst("emails");
+  const auto probes = probeKeys(stringKeys("emails"));
+  // one cursor per prefix, as stored by the upper index
+  std::map<std::string, uint32_t> prefixes;
+  std::vector<FST::Cursor> cursors;
+  std::vector<uint32_t> probe_cursors;
+  for (const auto &probe : probes) {
+    const std::string prefix = probe.substr(0, kHandOffLevel);
+    auto entry = prefixes.emplace(prefix, cursors.size());
+    if (entry.second) {
+      cursors.emplace_back(&fst);
+      cursors.back().descend(prefix);
+    }
+    probe_cursors.emplace_back(entry.first->second);
+  }
+  uint64_t i = 0;
+  uint64_t value = 0;
+  for (auto _ : state) {
+    const uint64_t probe = i++ & (kNumProbes - 1);
+    const FST::Cursor &cursor = cursors[probe_cursors[probe]];
+    if (use_cursor) {
+      benchmark::DoNotOptimize(cursor.lookupKey(probes[probe], value));
+    } else {
+      benchmark::DoNotOptimize(fst.lookupKeyAtNode(probes[probe].data(), probes[probe].size(),
+                                                   cursor.getLevel(), cursor.getNodeNum(), value));
+    }
+  }
+  benchmark::DoNotOptimize(value);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_HandOffLookup, lookupKeyAtNode, false);
+BENCHMARK_CAPTURE(BM_HandOffLookup, cursor, true);
+
+template <typename T>
+static void BM_LookupInt(benchmark::State &state) {
+  const FST &fst = intFst<T>();
+  const auto probes = probeKeys(intKeys<T>());
+  uint64_t i = 0;
+  uint64_t value = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fst.lookupKey(probes[i++ & (kNumProbes - 1)], value));
+  }
+  benchmark::DoNotOptimize(value);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_LookupInt, uint32_t);
+BENCHMARK_TEMPLATE(BM_LookupInt, uint64_t);
+
+template <typename T>
+static void BM_LookupIntFST(benchmark::State &state) {
+  const IntFST<T> &fst = typedIntFst<T>();
+  const auto probes = probeKeys(intKeys<T>());
+  uint64_t i = 0;
+  uint64_t value = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fst.lookupKey(probes[i++ & (kNumProbes - 1)], value));
+  }
+  benchmark::DoNotOptimize(value);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_LookupIntFST, uint32_t);
+BENCHMARK_TEMPLATE(BM_LookupIntFST, uint64_t);
+
+// sorted probes, as in a join on sorted IDs: one lookupKey per probe
+// against lookupSorted on all of them
+static void BM_LookupSortedProbes(benchmark::State &state, const bool batched) {
+  const FST &fst = intFst<uint64_t>();
+  auto probes = probeKeys(intKeys<uint64_t>());
+  std::sort(probes.begin(), probes.end());
+  std::vector<uint64_t> values(kNumProbes);
+  std::unique_ptr<bool[]> found(new bool[kNumProbes]);
+  for (auto _ : state) {
+    if (batched) {
+      fst.lookupSorted(probes.data(), kNumProbes, values.data(), found.get());
+    } else {
+      for (uint64_t i = 0; i < kNumProbes; i++) found[i] = fst.lookupKey(probes[i], values[i]);
+    }
+    benchmark::DoNotOptimize(found[kNumProbes - 1]);
+  }
+  state.SetItemsProcessed(state.iterations() * kNumProbes);
+}
+BENCHMARK_CAPTURE(BM_LookupSortedProbes, lookupKey, false);
+BENCHMARK_CAPTURE(BM_LookupSortedProbes, lookupSorted, true);
+
+// seeks to probe keys with their last byte changed, so that most seeks
+// land between two keys
+static void BM_MoveToKeyGreaterThan(benchmark::State &state, const std::string &dataset) {
+  if (stringKeys(dataset).empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  const FST &fst = stringFst(dataset);
+  auto probes = probeKeys(stringKeys(dataset));
+  for (auto &probe : probes) probe.back() = static_cast<char>(probe.back() + 1);
+  uint64_t i = 0;
+  for (auto _ : state) {
+    auto iter = fst.moveToKeyGreaterThan(probes[i++ & (kNumProbes - 1)], true);
+    benchmark::DoNotOptimize(iter.isValid());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_MoveToKeyGreaterThan, words, std::string("words"));
+BENCHMARK_CAPTURE(BM_MoveToKeyGreaterThan, emails, std::string("emails"));
+
+// ascending seeks that reuse one iterator, as in a merge join
+static void BM_SeekAscending(benchmark::State &state, const std::string &dataset) {
+  if (stringKeys(dataset).empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  const FST &fst = stringFst(dataset);
+  auto probes = probeKeys(stringKeys(dataset));
+  std::sort(probes.begin(), probes.end());
+  auto iter = fst.moveToFirst();
+  uint64_t i = 0;
+  for (auto _ : state) {
+    fst.seek(iter, probes[i++ & (kNumProbes - 1)], true);
+    benchmark::DoNotOptimize(iter.isValid());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_SeekAscending, words, std::string("words"));
+BENCHMARK_CAPTURE(BM_SeekAscending, emails, std::string("emails"));
+
+// a seek followed by state.range(0) iterator increments
+static void BM_IterScan(benchmark::State &state, const std::string &dataset) {
+  if (stringKeys(dataset).empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  const FST &fst = stringFst(dataset);
+  const auto probes = probeKeys(stringKeys(dataset));
+  const int64_t scan_length = state.range(0);
+  uint64_t i = 0;
+  uint64_t sum = 0;
+  for (auto _ : state) {
+    auto iter = fst.moveToKeyGreaterThan(probes[i++ & (kNumProbes - 1)], true);
+    for (int64_t n = 0; n < scan_length && iter.isValid(); n++) {
+      sum += iter.getValue();
+      iter++;
+    }
+  }
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations() * scan_length);
+}
+BENCHMARK_CAPTURE(BM_IterScan, words, std::string("words"))->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK_CAPTURE(BM_IterScan, emails, std::string("emails"))->Arg(10)->Arg(100)->Arg(1000);
+
+// sums the values handed over by FST::scan
+class SumSink : public ScanSink {
+ public:
+  explicit SumSink(bool with_keys) : with_keys_(with_keys) {}
+
+  bool wantsKeys() const override { return with_keys_; }
+
+  void consume(const uint64_t *values, const char *key_bytes,
+               const uint32_t *key_offsets, size_t num_keys) override {
+    for (size_t i = 0; i < num_keys; i++) sum += values[i];
+    if (with_keys_) sum += key_offsets[num_keys];
+    benchmark::DoNotOptimize(key_bytes);
+  }
+
+  uint64_t sum = 0;
+
+ private:
+  bool with_keys_;
+};
+
+// the same scans as BM_IterScan through FST::scan, state.range(1) selects
+// whether the keys are materialized as well
+static void BM_Scan(benchmark::State &state, const std::string &dataset) {
+  if (stringKeys(dataset).empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  const FST &fst = stringFst(dataset);
+  const auto probes = probeKeys(stringKeys(dataset));
+  const std::string right(1, (char) 0xff);
+  const int64_t scan_length = state.range(0);
+  SumSink sink(state.range(1) != 0);
+  uint64_t i = 0;
+  for (auto _ : state) {
+    fst.scan(probes[i++ & (kNumProbes - 1)], right, scan_length, sink);
+  }
+  benchmark::DoNotOptimize(sink.sum);
+  state.SetItemsProcessed(state.iterations() * scan_length);
+}
+BENCHMARK_CAPTURE(BM_Scan, words, std::string("words"))->ArgsProduct({{10, 100, 1000}, {0, 1}});
+BENCHMARK_CAPTURE(BM_Scan, emails, std::string("emails"))->ArgsProduct({{10, 100, 1000}, {0, 1}});
+
+// counts the keys of the ranges that BM_IterScan walks through, by rank
+static void BM_CountRange(benchmark::State &state, const std::string &dataset) {
+  const auto &keys = stringKeys(dataset);
+  if (keys.empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  const FST &fst = stringFst(dataset);
+  const auto probes = probeKeys(keys);
+  uint64_t i = 0;
+  uint64_t sum = 0;
+  for (auto _ : state) {
+    const auto &left = probes[i++ & (kNumProbes - 1)];
+    const auto &right = keys[std::min<size_t>(fst.rankOf(left) + 1000, keys.size() - 1)];
+    sum += fst.countRange(left, right);
+  }
+  benchmark::DoNotOptimize(sum);
+}
+BENCHMARK_CAPTURE(BM_CountRange, words, std::string("words"));
+BENCHMARK_CAPTURE(BM_CountRange, emails, std::string("emails"));
+
+static void BM_AtOrdinal(benchmark::State &state, const std::string &dataset) {
+  const auto &keys = stringKeys(dataset);
+  if (keys.empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  const FST &fst = stringFst(dataset);
+  std::mt19937_64 rng(kSeed);
+  uint64_t sum = 0;
+  for (auto _ : state) {
+    sum += fst.atOrdinal(rng() % keys.size()).getValue();
+  }
+  benchmark::DoNotOptimize(sum);
+}
+BENCHMARK_CAPTURE(BM_AtOrdinal, words, std::string("words"));
+BENCHMARK_CAPTURE(BM_AtOrdinal, emails, std::string("emails"));
+
+// scans all keys on state.range(0) threads
+static void BM_ScanParallel(benchmark::State &state, const std::string &dataset) {
+  const auto &keys = stringKeys(dataset);
+  if (keys.empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  const FST &fst = stringFst(dataset);
+  const std::string right(1, (char) 0xff);
+  std::vector<SumSink> sinks(state.range(0), SumSink(false));
+  std::vector<ScanSink *> sink_ptrs;
+  for (auto &sink : sinks) sink_ptrs.push_back(&sink);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fst.scanParallel("", right, sink_ptrs));
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_CAPTURE(BM_ScanParallel, words, std::string("words"))
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_ScanParallel, emails, std::string("emails"))
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// BM_Scan over a separate FST with every state.range(1)-th key erased
+static void BM_ScanErased(benchmark::State &state, const std::string &dataset) {
+  const auto &keys = stringKeys(dataset);
+  if (keys.empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  FST fst(keys, sequentialValues(keys.size()));
+  for (size_t i = 0; i < keys.size(); i += state.range(1)) fst.erase(keys[i]);
+  const auto probes = probeKeys(keys);
+  const std::string right(1, (char) 0xff);
+  const int64_t scan_length = state.range(0);
+  SumSink sink(false);
+  uint64_t i = 0;
+  for (auto _ : state) {
+    fst.scan(probes[i++ & (kNumProbes - 1)], right, scan_length, sink);
+  }
+  benchmark::DoNotOptimize(sink.sum);
+  state.SetItemsProcessed(state.iterations() * scan_length);
+}
+BENCHMARK_CAPTURE(BM_ScanErased, words, std::string("words"))->ArgsProduct({{100, 1000}, {2, 10, 1000}});
+BENCHMARK_CAPTURE(BM_ScanErased, emails, std::string("emails"))->ArgsProduct({{100, 1000}, {2, 10, 1000}});
+
+static void BM_BuildString(benchmark::State &state, const std::string &dataset) {
+  const auto &keys = stringKeys(dataset);
+  if (keys.empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  const auto values = sequentialValues(keys.size());
+  for (auto _ : state) {
+    FST fst(keys, values);
+    benchmark::DoNotOptimize(fst.getMemoryUsage());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_CAPTURE(BM_BuildString, words, std::string("words"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_BuildString, emails, std::string("emails"))->Unit(benchmark::kMillisecond);
+
+// merges two FSTs that hold every other key and overlap in every tenth
+static void BM_Merge(benchmark::State &state, const std::string &dataset) {
+  const auto &keys = stringKeys(dataset);
+  if (keys.empty()) {
+    state.SkipWithError("no keys, words.txt missing?");
+    return;
+  }
+  std::vector<std::string> keys_a, keys_b;
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (i % 2 == 0 || i % 10 == 1) keys_a.emplace_back(keys[i]);
+    if (i % 2 == 1) keys_b.emplace_back(keys[i]);
+  }
+  const FST a(keys_a, sequentialValues(keys_a.size()));
+  const FST b(keys_b, sequentialValues(keys_b.size()));
+  for (auto _ : state) {
+    auto merged = FST::merge(a, b, [](std::string_view, uint64_t, uint64_t value_b) {
+      return value_b;
+    });
+    benchmark::DoNotOptimize(merged->getMemoryUsage());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_CAPTURE(BM_Merge, words, std::string("words"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Merge, emails, std::string("emails"))->Unit(benchmark::kMillisecond);
+
+static void BM_BuildUint64(benchmark::State &state) {
+  const auto &keys = intKeys<uint64_t>();
+  const auto values = sequentialValues(keys.size());
+  for (auto _ : state) {
+    FST fst(keys, values);
+    benchmark::DoNotOptimize(fst.getMemoryUsage());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_BuildUint64)->Unit(benchmark::kMillisecond);
+
+static void BM_BuildIntFST(benchmark::State &state) {
+  const auto &keys = intKeys<uint64_t>();
+  const auto values = sequentialValues(keys.size());
+  for (auto _ : state) {
+    IntFST<uint64_t> fst(keys, values);
+    benchmark::DoNotOptimize(fst.getMemoryUsage());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_BuildIntFST)->Unit(benchmark::kMillisecond);
+
+}  // namespace bench
+
+}  // namespace fst
+
+BENCHMARK_MAIN();
@@ -0,0 +1,128 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "bench_data.hpp"
+#include "config.hpp"
+#include "label_vector.hpp"
+#include "rank.hpp"
+#include "select.hpp"
+
+namespace fst {
+
+namespace bench {
+
+static const position_t kNumBits = 1 << 24;
+static const position_t kRankBasicBlockSize = 512;
+static const position_t kSelectSampleInterval = 64;
+static const position_t kNumLabels = 1 << 22;
+
+// one level of kNumBits bits with a density of 1 / 2^sparsity
+static std::vector<std::vector<word_t>> randomBits(const int sparsity) {
+  std::mt19937_64 gen(kSeed);
+  std::vector<word_t> bits(kNumBits / kWordSize);
+  for (auto &word : bits) {
+    word = gen();
+    for (int i = 0; i < sparsity; i++) word &= gen();
+  }
+  return {bits};
+}
+
+static std::vector<position_t> randomPositions(const position_t bound) {
+  std::mt19937_64 gen(kSeed + 1);
+  std::vector<position_t> positions(kNumProbes);
+  for (auto &pos : positions) pos = gen() % bound;
+  return positions;
+}
+
+static void BM_Rank(benchmark::State &state) {
+  const BitvectorRank bv(kRankBasicBlockSize, randomBits(state.range(0)), {kNumBits});
+  const auto positions = randomPositions(kNumBits);
+  uint64_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(bv.rank(positions[i++ & (kNumProbes - 1)]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Rank)->Arg(0)->Arg(3);
+
+static void BM_Select(benchmark::State &state) {
+  const BitvectorSelect bv(kSelectSampleInterval, randomBits(state.range(0)), {kNumBits});
+  auto ranks = randomPositions(bv.numOnes());
+  for (auto &rank : ranks) rank++;  // ranks are one-based
+  uint64_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(bv.select(ranks[i++ & (kNumProbes - 1)]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Select)->Arg(0)->Arg(3);
+
+// Nodes of state.range(0) sorted labels each, as in LOUDS-Sparse, and
+// probes of a random node with a random target label.
+class LabelSearchFixture : public benchmark::Fixture {
+ public:
+  void SetUp(const benchmark::State &state) override {
+    node_size_ = state.range(0);
+    std::mt19937_64 gen(kSeed);
+    std::vector<label_t> all_labels(kFanout - 1);  // no terminator labels
+    std::iota(all_labels.begin(), all_labels.end(), 0);
+    std::vector<label_t> level;
+    level.reserve(kNumLabels);
+    while (level.size() + node_size_ <= kNumLabels) {
+      std::shuffle(all_labels.begin(), all_labels.end(), gen);
+      std::vector<label_t> node(all_labels.begin(), all_labels.begin() + node_size_);
+      std::sort(node.begin(), node.end());
+      level.insert(level.end(), node.begin(), node.end());
+    }
+    num_nodes_ = level.size() / node_size_;
+    labels_ = std::make_unique<LabelVector>(std::vector<std::vector<label_t>>{level});
+
+    nodes_ = randomPositions(num_nodes_);
+    targets_.resize(kNumProbes);
+    for (auto &target : targets_) target = gen() % (kFanout - 1);
+  }
+
+  void TearDown(const benchmark::State &) override { labels_.reset(); }
+
+ protected:
+  position_t node_size_ = 0;
+  position_t num_nodes_ = 0;
+  std::unique_ptr<LabelVector> labels_;
+  std::vector<position_t> nodes_;
+  std::vector<label_t> targets_;
+};
+
+BENCHMARK_DEFINE_F(LabelSearchFixture, Search)(benchmark::State &state) {
+  uint64_t i = 0;
+  for (auto _ : state) {
+    const uint64_t probe = i++ & (kNumProbes - 1);
+    position_t pos = nodes_[probe] * node_size_;
+    benchmark::DoNotOptimize(labels_->search(targets_[probe], pos, node_size_));
+    benchmark::DoNotOptimize(pos);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(LabelSearchFixture, Search)->Arg(2)->Arg(8)->Arg(16)->Arg(48)->Arg(128)->Arg(255);
+
+BENCHMARK_DEFINE_F(LabelSearchFixture, SearchGreaterThan)(benchmark::State &state) {
+  uint64_t i = 0;
+  for (auto _ : state) {
+    const uint64_t probe = i++ & (kNumProbes - 1);
+    position_t pos = nodes_[probe] * node_size_;
+    benchmark::DoNotOptimize(labels_->searchGreaterThan(targets_[probe], pos, node_size_));
+    benchmark::DoNotOptimize(pos);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(LabelSearchFixture, SearchGreaterThan)->Arg(2)->Arg(8)->Arg(16)->Arg(48)->Arg(128)->Arg(255);
+
+}  // namespace bench
+
+}  // namespace fst
+
+BENCHMARK_MAIN();
@@ -10,12 +10,13 @@ namespace fst {
 
 class Bitvector {
  public:
-  Bitvector() : num_bits_(0), bits_(nullptr){};
+  Bitvector() : num_bits_(0), bits_(nullptr), owns_memory_(true){};
 
   Bitvector(const std::vector<std::vector<word_t> > &bitvector_per_level,
             const std::vector<position_t> &num_bits_per_level,
             const level_t start_level = 0,
-            level_t end_level = 0 /* non-inclusive */) {
+            level_t end_level = 0 /* non-inclusive */)
+      : owns_memory_(true) {
     if (end_level == 0) end_level = bitvector_per_level.size();
     num_bits_ = totalNumBits(num_bits_per_level, start_level, end_level);
     bits_ = new word_t[numWords()];
@@ -43,6 +44,10 @@ class Bitvector {
 
   bool readBit(position_t pos) const;
 
+  void prefetch(position_t pos) const {
+    __builtin_prefetch(bits_ + (pos / kWordSize));
+  }
+
   position_t distanceToNextSetBit(position_t pos) const;
   position_t distanceToPrevSetBit(position_t pos) const;
 
@@ -61,6 +66,8 @@ class Bitvector {
  protected:
   position_t num_bits_;
   word_t *bits_;
+  // false if the bits and lookup tables point into a serialized buffer
+  bool owns_memory_;
 };
 
 bool Bitvector::readBit(const position_t pos) const {
@@ -72,6 +79,8 @@ bool Bitvector::readBit(const position_t pos) const {
 
 position_t Bitvector::distanceToNextSetBit(const position_t pos) const {
   assert(pos < num_bits_);
+  // the word after the last bit may not exist
+  if (pos + 1 == num_bits_) return (num_bits_ - pos);
   position_t distance = 1;
 
   position_t word_id = (pos + 1) / kWordSize;
@@ -92,7 +101,8 @@ position_t Bitvector::distanceToNextSetBit(const position_t pos) const {
     if (test_bits > 0) return (distance + __builtin_clzll(test_bits));
     distance += kWordSize;
   }
-  return distance;
+  // no set bit follows: the distance ends at the last bit
+  return (num_bits_ - pos);
 }
 
 size_t Bitvector::getNumSetBitsInDenseNode(position_t nodeNumber, unsigned &label) const {
@@ -100,7 +110,7 @@ size_t Bitvector::getNumSetBitsInDenseNode(position_t nodeNumber, unsigned &labe
   for (auto i = 0; i < 4; i++) {
     setBits += __builtin_popcountll(bits_[nodeNumber * (kFanout / kWordSize) + i]);
     if (bits_[nodeNumber * (kFanout / kWordSize) + i] > 0) {
-     label = __builtin_clz(bits_[nodeNumber * (kFanout / kWordSize) + i] > 0) + kWordSize * i;
+     label = __builtin_clzll(bits_[nodeNumber * (kFanout / kWordSize) + i]) + kWordSize * i;
     }
   }
   return setBits;
@@ -168,7 +178,10 @@ void Bitvector::concatenateBitvectors(
         bit_shift += bits_remain;
       } else {
         word_id++;
-        bits_[word_id] |= (last_word << (kWordSize - bit_shift));
+        // nothing spills over if the level ends on a word boundary; the next
+        // word may not even exist
+        if (bit_shift + bits_remain > kWordSize)
+          bits_[word_id] |= (last_word << (kWordSize - bit_shift));
         bit_shift = bit_shift + bits_remain - kWordSize;
       }
     }
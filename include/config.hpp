@@ -7,7 +7,15 @@
 namespace fst {
 
 using level_t = uint32_t;
+// Positions index the bits of the bitvectors and the labels, values and
+// suffixes of the trie. 32 bits limit a trie to 2^32 items per bitvector and
+// LoudsDense to 2^24 nodes; FST_WIDE_POSITION lifts both limits at the cost
+// of twice the size for the rank and select look-up tables.
+#ifdef FST_WIDE_POSITION
+using position_t = uint64_t;
+#else
 using position_t = uint32_t;
+#endif
 
 using label_t = uint8_t;
 static const position_t kFanout = 256;
@@ -21,12 +29,52 @@ static const bool kIncludeDense = true;
 // static const uint32_t kSparseDenseRatio = 64;
 static const uint32_t kSparseDenseRatio = 16;
 static const label_t kTerminator = 255;
+// store the key bytes after the unique prefix to verify lookups and seeks
+static const bool kIncludeSuffixes = true;
 
 static const int kHashShift = 7;
 
+static const size_t kCacheLineSize = 64;
+
+// iterators of tries up to this height do not allocate, see IterPath
+static const level_t kIterInlineHeight = 48;
+
+// number of keys FST::scan hands to a ScanSink at once
+static const size_t kScanBlockSize = 1024;
+
+// number of writes an UpdatableFST buffers before it rebuilds its FST
+static const size_t kDeltaLimit = 4096;
+
+// number of lookups that are interleaved by the batched lookup engine
+static const unsigned kLookupBatchSize = 32;
+
+// outcome of a single trie step of a point lookup
+enum class StepResult : uint8_t { kChild, kValue, kMiss };
+
+// encoding of the leaf values, see ValueVector
+enum class ValueEncoding : uint8_t { kPlain, kBitPacked, kFrameOfReference, kAuto };
+static const ValueEncoding kValueEncoding = ValueEncoding::kAuto;
+// number of values per frame-of-reference block
+static const position_t kValueBlockSize = 64;
+
+// how FSTBuilder picks the first LOUDS-Sparse level, see setCutoffPolicy
+enum class CutoffPolicy : uint8_t { kSizeRatio, kLookupCost };
+static const CutoffPolicy kCutoffPolicy = CutoffPolicy::kSizeRatio;
+// modelled cost of a lookup step in cache lines: a dense step reads the label
+// and child bitmaps and a rank block, a sparse step the select and rank
+// samples, the louds and child words, plus one line per 64 labels it searches
+static const uint64_t kDenseStepCost = 3;
+static const uint64_t kSparseStepCost = 4;
+// the lookup cost model assumes that this many bytes of the upper trie levels
+// stay cached, and that a line that misses costs kCacheMissCost hits
+static const uint64_t kCutoffCacheSize = 1 << 20;
+static const uint64_t kCacheMissCost = 10;
+
 void align(char *&ptr) { ptr = (char *)(((uint64_t)ptr + 7) & ~((uint64_t)7)); }
 
+#ifndef FST_WIDE_POSITION
 void sizeAlign(position_t &size) { size = (size + 7) & ~((position_t)7); }
+#endif
 
 void sizeAlign(uint64_t &size) { size = (size + 7) & ~((uint64_t)7); }
 
@@ -40,6 +88,12 @@ std::string uint32ToString(const uint32_t word) {
   return std::string(reinterpret_cast<const char *>(&endian_swapped_word), 4);
 }
 
+// number of leading bytes that the width-byte integers a and b share, a != b
+inline level_t commonPrefixBytes(const uint64_t a, const uint64_t b,
+                                 const level_t width) {
+  return (__builtin_clzll(a ^ b) - (64 - 8 * width)) / 8;
+}
+
 uint64_t stringToUint64(const std::string &str_word) {
   uint64_t int_word = 0;
   memcpy(reinterpret_cast<char *>(&int_word), str_word.data(), 8);
@@ -1,19 +1,85 @@
 #ifndef SURF_H_
 #define SURF_H_
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "config.hpp"
 #include "fst_builder.hpp"
+#include "hash.hpp"
 #include "louds_dense.hpp"
 #include "louds_sparse.hpp"
 
 namespace fst {
 
+// Header of the files written by FST::writeTo; the serialized trie follows.
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;  // build options that change the layout, see kFileFlags
+  uint64_t payload_size;
+  uint32_t checksum;  // Hash() of the payload
+  uint32_t reserved;
+  // pads the header to a cache line, so that the payload of a mapped file
+  // is aligned like the buffer writeTo serializes into
+  char padding[32];
+};
+static_assert(sizeof(FileHeader) == kCacheLineSize, "the payload must be cache line aligned");
+
+static const char kFileMagic[8] = {'F', 'S', 'T', 'I', 'N', 'D', 'E', 'X'};
+static const uint32_t kFileVersion = 7;
+static const uint32_t kFileChecksumSeed = 0x5f5f4653;
+
+// the rank vectors use BitvectorRankInterleaved
+static const uint32_t kFileFlagInterleavedRank = 1;
+// positions and look-up tables are 64 bits wide
+static const uint32_t kFileFlagWidePosition = 2;
+#ifdef FST_INTERLEAVED_RANK
+static const uint32_t kFileFlagsRank = kFileFlagInterleavedRank;
+#else
+static const uint32_t kFileFlagsRank = 0;
+#endif
+#ifdef FST_WIDE_POSITION
+static const uint32_t kFileFlagsPosition = kFileFlagWidePosition;
+#else
+static const uint32_t kFileFlagsPosition = 0;
+#endif
+static const uint32_t kFileFlags = kFileFlagsRank | kFileFlagsPosition;
+
+// Receives the keys and values of FST::scan in blocks of up to
+// kScanBlockSize keys. The buffers are only valid during consume.
+class ScanSink {
+ public:
+  virtual ~ScanSink() = default;
+
+  // if false, scan only emits the values
+  virtual bool wantsKeys() const = 0;
+
+  // Key i is key_bytes[key_offsets[i], key_offsets[i + 1]); both are
+  // nullptr if wantsKeys() is false.
+  virtual void consume(const uint64_t *values, const char *key_bytes,
+                       const uint32_t *key_offsets, size_t num_keys) = 0;
+};
+
+template <typename T>
+class IntFST;
+
 class FST {
  public:
+  class Cursor;
+
   class Iter {
    public:
     Iter() = default;
@@ -27,13 +93,24 @@ class FST {
 
     bool isValid() const;
 
-    int compare(const std::string &key) const;
+    int compare(std::string_view key) const;
 
     uint64_t getValue() const;
 
+    // unique prefix of the current key
     std::string getKey() const;
 
-    // Returns true if the status of the iterator after the operation is valid
+    // getKey without a copy; invalidated by moving the iterator
+    std::string_view keyView() const;
+
+    // key bytes after getKey(), if suffixes are stored
+    std::string_view getSuffix() const;
+
+    // complete current key; equals getKey() if suffixes are not stored
+    std::string getFullKey() const;
+
+    // Returns true if the status of the iterator after the operation is valid.
+    // Erased keys are skipped.
     bool operator++(int);
 
     bool operator--(int);
@@ -43,6 +120,14 @@ class FST {
    private:
     void passToSparse();
 
+    bool isErased() const;
+
+    // moves on to the next key that has not been erased
+    void skipErased();
+
+    // moves back to the previous key that has not been erased
+    void skipErasedBackward();
+
     bool incrementDenseIter();
 
     bool incrementSparseIter();
@@ -57,6 +142,7 @@ class FST {
     LoudsSparse::Iter sparse_iter_;
 
     friend class FST;
+    friend class Cursor;
   };
 
  public:
@@ -69,16 +155,15 @@ class FST {
     create(keys, values, kIncludeDense, kSparseDenseRatio);
   }
 
+  // Keys are length-prefixed byte strings at data + offsets[i].
   FST(const std::vector<uint32_t> &offsets, const std::vector<uint64_t> &values, const uint8_t *data) {
-    keys_.reserve(offsets.size());
-
-    for (auto offset: offsets) {
-      uint8_t key_length = data[offset];
-      std::string key(reinterpret_cast<const char *>(data) + offset + 1, key_length);
-      keys_.emplace_back(move(key));
+    FSTBuilder builder(kIncludeDense, kSparseDenseRatio);
+    for (size_t i = 0; i < offsets.size(); i++) {
+      uint8_t key_length = data[offsets[i]];
+      builder.add(std::string_view(reinterpret_cast<const char *>(data) + offsets[i] + 1, key_length), values[i]);
     }
-
-    create(keys_, values, kIncludeDense, kSparseDenseRatio);
+    builder.finish();
+    create(builder);
   }
 
   FST(const std::vector<uint64_t> &keys, const std::vector<uint64_t> &values) {
@@ -103,22 +188,65 @@ class FST {
     create(transformed_keys, values, kIncludeDense, kSparseDenseRatio);
   }
 
+  // num_threads > 1 builds partitions of the key list concurrently
   FST(const std::vector<std::string> &keys, const std::vector<uint64_t> &values, const bool include_dense,
-      const uint32_t sparse_dense_ratio) {
-    create(keys, values, include_dense, sparse_dense_ratio);
+      const uint32_t sparse_dense_ratio, const unsigned num_threads = 1,
+      const bool include_suffixes = kIncludeSuffixes) {
+    create(keys, values, include_dense, sparse_dense_ratio, num_threads, include_suffixes);
   }
 
-  ~FST() = default;
+  // Builds the FST from a builder that was filled with FSTBuilder::add
+  // and FSTBuilder::finish. The builder is not needed afterwards.
+  explicit FST(const FSTBuilder &builder) { create(builder); }
+
+  ~FST() {
+    if (mapped_data_ != nullptr) munmap(mapped_data_, mapped_size_);
+  }
 
+  // Without suffixes, only the unique prefixes of the keys are stored:
+  // lookups and seeks then cannot tell keys apart that share such a prefix.
   void create(const std::vector<std::string> &keys, const std::vector<uint64_t> &values, bool include_dense,
-              uint32_t sparse_dense_ratio);
+              uint32_t sparse_dense_ratio, unsigned num_threads = 1,
+              bool include_suffixes = kIncludeSuffixes);
 
-  bool lookupKey(const std::string &key, uint64_t &value) const;
+  void create(const FSTBuilder &builder);
+
+  bool lookupKey(std::string_view key, uint64_t &value) const;
 
   bool lookupKey(uint32_t key, uint64_t &value) const;
 
   bool lookupKey(uint64_t key, uint64_t &value) const;
 
+  // Marks key as erased: lookups no longer find it and iterators skip it.
+  // The trie keeps its shape, so rankOf, countRange, atOrdinal,
+  // partitionRange and getNumKeys still count erased keys. A key is erased
+  // with a single atomic operation, concurrent lookups and iterators see
+  // either the old or the new state. Erased keys are written by serialize.
+  // Returns false if key does not exist or has been erased before.
+  bool erase(std::string_view key);
+
+  // Batched point lookups: looks up keys[0..n) and stores the results in
+  // values[i] and found[i]. Lookups are advanced in groups of
+  // kLookupBatchSize and interleaved level by level, so that the cache misses
+  // of one lookup are hidden behind the work of the others.
+  void lookupKeys(const std::string *keys, size_t n, uint64_t *values,
+                  bool *found) const;
+
+  void lookupKeys(const std::string_view *keys, size_t n, uint64_t *values,
+                  bool *found) const;
+
+  // Looks up the integer keys[0..n) like lookupKey(uint64_t). A lookup
+  // resumes the walk of the previous key at the first byte in which the two
+  // keys differ, so on sorted keys, which share most of their leading
+  // bytes, it mostly steps through the last one or two levels only. Keys
+  // in any order are found, but only sorted keys save steps.
+  void lookupSorted(const uint64_t *keys, size_t n, uint64_t *values,
+                    bool *found) const;
+
+  // The following functions are used by the hybrid trie, which stores the
+  // upper levels in an ART and hands off to the FST below. FST::Cursor offers
+  // the same hand-off without tagged node numbers.
+
   // this function is used by hybrid trie to continue a search started in ARTHybrid
   inline bool lookupKeyAtNode(const char *key, uint64_t key_length, level_t level, size_t node_number,
                               uint64_t &value) const;
@@ -137,20 +265,72 @@ class FST {
 
   void moveToLeftmostKeyStartingAtNode(level_t level, size_t node_number, FST::Iter& iter) const;
 
-  FST::Iter moveToKeyStartingAtNode(level_t &level, size_t node_number, const std::string &key) const;
+  FST::Iter moveToKeyStartingAtNode(level_t &level, size_t node_number, std::string_view key) const;
 
   // This function searches in a conservative way: if inclusive is true
   // and the stored key prefix matches key, iter stays at this key prefix.
-  FST::Iter moveToKeyGreaterThan(const std::string &key, bool inclusive) const;
+  FST::Iter moveToKeyGreaterThan(std::string_view key, bool inclusive) const;
+
+  // Moves iter, which must have been created by this FST, to the same key
+  // as moveToKeyGreaterThan. The levels that key shares with the current
+  // position of iter are not walked again, so that a sequence of seeks to
+  // nearby keys, e.g. in ascending order, reuses most of the trie walks.
+  void seek(FST::Iter &iter, std::string_view key, bool inclusive) const;
 
-  FST::Iter moveToKeyLessThan(const std::string &key, bool inclusive) const;
+  FST::Iter moveToKeyLessThan(std::string_view key, bool inclusive) const;
 
   FST::Iter moveToFirst() const;
 
   FST::Iter moveToLast() const;
 
-  std::pair<FST::Iter, FST::Iter> lookupRange(const std::string &left_key, bool left_inclusive,
-                                              const std::string &right_key, bool right_inclusive);
+  // Emits the values, and the keys if requested, of the first limit keys in
+  // [left, right) to sink. Returns the number of keys emitted, 0 if
+  // left >= right. Without stored suffixes, a key that shares its unique
+  // prefix with right counts as equal to it, as in rankOf.
+  size_t scan(std::string_view left, std::string_view right, size_t limit,
+              ScanSink &sink) const;
+
+  // Number of keys less than key, in O(height) without iterating. Without
+  // stored suffixes, a key that shares its unique prefix with key counts as
+  // equal to it.
+  uint64_t rankOf(std::string_view key) const;
+
+  // number of keys in [left, right)
+  uint64_t countRange(std::string_view left, std::string_view right) const;
+
+  // Iterator on the key with the given ordinal, i.e. with ordinal keys in
+  // front of it, or an invalid iterator if ordinal >= getNumKeys(). Each
+  // node on the way down is binary searched for the child whose subtrie holds
+  // the key, and every count follows the subtries down to the deepest level,
+  // so a call costs O(height^2 * log fanout) rank operations. That beats
+  // iterating to large ordinals, but is far more than a single rankOf.
+  FST::Iter atOrdinal(uint64_t ordinal) const;
+
+  // Splits [left, right) into k consecutive ranges whose numbers of keys
+  // differ by at most one.
+  std::vector<std::pair<std::string, std::string>> partitionRange(
+      std::string_view left, std::string_view right, size_t k) const;
+
+  // Scans [left, right) in parallel: sink i receives the keys of range i of
+  // partitionRange(left, right, sinks.size()). At most
+  // std::thread::hardware_concurrency() threads, including the calling one,
+  // take the ranges in order. Returns the number of keys scanned.
+  size_t scanParallel(std::string_view left, std::string_view right,
+                      const std::vector<ScanSink *> &sinks) const;
+
+  // Builds an FST of the keys of a and b by a sorted merge of their
+  // iterators that feeds an FSTBuilder key by key, so that only the current
+  // key of each input is held in memory next to the new trie. For a key in
+  // both inputs, the value is resolve(key, value_in_a, value_in_b).
+  // Erased keys are dropped. Keys are compared completely, so both inputs
+  // must store suffixes, see hasSuffixes; otherwise std::invalid_argument is
+  // thrown. Returns nullptr if no key remains.
+  template <typename Resolver>
+  static std::unique_ptr<FST> merge(const FST &a, const FST &b,
+                                    Resolver resolve);
+
+  std::pair<FST::Iter, FST::Iter> lookupRange(std::string_view left_key, bool left_inclusive,
+                                              std::string_view right_key, bool right_inclusive);
 
   uint64_t serializedSize() const;
 
@@ -160,9 +340,16 @@ class FST {
 
   level_t getSparseStartLevel() const;
 
+  uint64_t getNumKeys() const;
+
+  // false if the FST was built without include_suffixes
+  bool hasSuffixes() const {
+    return louds_dense_->hasSuffixes() || louds_sparse_->hasSuffixes();
+  }
+
   char *serialize() const {
     uint64_t size = serializedSize();
-    char *data = new char[size];
+    char *data = new char[size]();
     char *cur_data = data;
     louds_dense_->serialize(cur_data);
     louds_sparse_->serialize(cur_data);
@@ -178,61 +365,354 @@ class FST {
     return surf;
   }
 
+  // Writes the serialized trie, including its values, to path. The file
+  // starts with a FileHeader holding a checksum of the serialized trie.
+  void writeTo(const std::string &path) const;
+
+  // Maps a file written by writeTo into memory and serves lookups directly
+  // from the mapping, i.e. nothing is copied and the page cache is shared
+  // between processes that open the same file.
+  // Throws std::runtime_error if the file cannot be mapped or its header
+  // is invalid. Verifying the checksum reads the whole file.
+  static std::unique_ptr<FST> open(const std::string &path,
+                                   bool verify_checksum = true);
+
+ private:
+  // state of a single lookup in the batched lookup engine
+  struct BatchLookupState {
+    size_t idx;  // index into keys, values and found
+    position_t node_num;  // current node, or the leaf level of a hit
+    position_t pos;  // first label position (sparse) or value position
+  };
+
+  // Looks up keys[first, first + count) in lock step: on every level, all
+  // lookups of the group first prefetch the cache lines of their next step
+  // and only then execute it.
+  // Key is std::string or std::string_view
+  template <typename Key>
+  void lookupKeyGroup(const Key *keys, size_t first, size_t count,
+                      uint64_t *values, bool *found) const;
+
+  // lookupSorted for the sizeof(T) big endian bytes of integer keys
+  template <typename T>
+  void lookupSortedIntegers(const T *keys, size_t n, uint64_t *values,
+                            bool *found) const;
+
  private:
-  std::vector<std::string> keys_;
   std::unique_ptr<LoudsSparse> louds_sparse_;
   std::unique_ptr<FSTBuilder> builder_;
   std::unique_ptr<LoudsDense> louds_dense_;
 
   FST::Iter iter_;
   FST::Iter end_;
+
+  // walks louds_dense_ and louds_sparse_ directly
+  template <typename T>
+  friend class IntFST;
+
+  // file mapping created by open()
+  void *mapped_data_ = nullptr;
+  size_t mapped_size_ = 0;
+};
+
+// A position in the trie that an upper index, e.g. an ART or a hash table
+// over the leading key bytes, keeps to hand lookups and seeks off to the FST
+// without walking the trie from the root again. A cursor is a node, or the
+// leaf that the last step ended in, together with the number of key bytes
+// consumed to reach it. Cursors are small and can be copied freely; they
+// stay valid as long as the FST.
+class FST::Cursor {
+ public:
+  Cursor() = default;
+
+  // on the root node
+  explicit Cursor(const FST *fst) : Cursor(fst, 0, 0) {}
+
+  // on node node_num of level level, e.g. a node number that
+  // lookupNodeNum returned for a key prefix of length level
+  Cursor(const FST *fst, level_t level, position_t node_num);
+
+  // false once a step did not find its label
+  bool isValid() const { return state_ != StepResult::kMiss; }
+
+  // true once a step ended in a leaf
+  bool isAtValue() const { return state_ == StepResult::kValue; }
+
+  // number of key bytes consumed
+  level_t getLevel() const { return level_; }
+
+  position_t getNodeNum() const { return node_num_; }
+
+  // the node, or the label of the leaf, lies on a dense level
+  bool isDense() const { return is_dense_; }
+
+  // Consumes one key byte: moves to the child node of label, or onto the
+  // leaf label ends in. Returns false, and invalidates the cursor, if the
+  // node has no such label. The cursor must be on a node.
+  bool step(label_t label);
+
+  // Steps through the bytes of prefix until a leaf is reached. The bytes
+  // after the leaf's label are not compared with its suffix, use lookupKey
+  // for that. Returns false if a byte has no label.
+  bool descend(std::string_view prefix);
+
+  // Value of the leaf the cursor is on. Only the unique prefix of its key
+  // has been matched.
+  uint64_t value() const;
+
+  // Looks up key, whose first getLevel() bytes led to the cursor, from the
+  // cursor on. The cursor does not move.
+  bool lookupKey(std::string_view key, uint64_t &value) const;
+
+  // Iterator on the first key in the subtrie of the cursor's node that is
+  // not less than key, whose first getLevel() bytes led to the cursor. As
+  // with moveToKeyStartingAtNode, the keys of the iterator start after
+  // these bytes and it ends with the subtrie. The cursor must be on a node.
+  FST::Iter seekGE(std::string_view key) const;
+
+ private:
+  const FST *fst_ = nullptr;
+  level_t level_ = 0;
+  position_t node_num_ = 0;
+  // on a sparse node: position of its first label
+  position_t pos_ = 0;
+  // on a leaf: index of its value
+  position_t value_pos_ = 0;
+  bool is_dense_ = false;
+  // kChild: on node node_num_, kValue: on a leaf, kMiss: invalid
+  StepResult state_ = StepResult::kChild;
 };
 
 void FST::create(const std::vector<std::string> &keys, const std::vector<uint64_t> &values, const bool include_dense,
-                 const uint32_t sparse_dense_ratio) {
-  builder_ = std::make_unique<FSTBuilder>(include_dense, sparse_dense_ratio);
-  builder_->build(keys, values);
-  louds_dense_ = std::make_unique<LoudsDense>(builder_.get(), keys);
-  louds_sparse_ = std::make_unique<LoudsSparse>(builder_.get(), keys);
+                 const uint32_t sparse_dense_ratio, const unsigned num_threads,
+                 const bool include_suffixes) {
+  builder_ = std::make_unique<FSTBuilder>(include_dense, sparse_dense_ratio, include_suffixes);
+  builder_->build(keys, values, num_threads);
+  louds_dense_ = std::make_unique<LoudsDense>(builder_.get());
+  louds_sparse_ = std::make_unique<LoudsSparse>(builder_.get());
   iter_ = FST::Iter(this);
   builder_.reset();
 }
 
-bool FST::lookupKey(const uint32_t key, uint64_t &value) const {
-  // transform uint32 to string
-  uint32_t endian_swapped_word = __builtin_bswap32(key);
-  std::string transformed_key = std::string(reinterpret_cast<const char *>(&endian_swapped_word), 4);
+void FST::create(const FSTBuilder &builder) {
+  louds_dense_ = std::make_unique<LoudsDense>(&builder);
+  louds_sparse_ = std::make_unique<LoudsSparse>(&builder);
+  iter_ = FST::Iter(this);
+}
 
-  position_t connect_node_num = 0;
-  if (!louds_dense_->lookupKey(transformed_key, connect_node_num, value))
-    return false;
-  else if (connect_node_num != 0)
-    return louds_sparse_->lookupKey(transformed_key, connect_node_num, value);
-  return true;
+bool FST::lookupKey(const uint32_t key, uint64_t &value) const {
+  // the key bytes are viewed in place, big endian
+  const uint32_t endian_swapped_word = __builtin_bswap32(key);
+  return lookupKey(std::string_view(reinterpret_cast<const char *>(&endian_swapped_word), 4), value);
 }
 
 bool FST::lookupKey(const uint64_t key, uint64_t &value) const {
-  // transform uint32 to string
-  uint64_t endian_swapped_word = __builtin_bswap64(key);
-  std::string transformed_key = std::string(reinterpret_cast<const char *>(&endian_swapped_word), 8);
+  // the key bytes are viewed in place, big endian
+  const uint64_t endian_swapped_word = __builtin_bswap64(key);
+  return lookupKey(std::string_view(reinterpret_cast<const char *>(&endian_swapped_word), 8), value);
+}
 
+bool FST::lookupKey(std::string_view key, uint64_t &value) const {
   position_t connect_node_num = 0;
-  if (!louds_dense_->lookupKey(transformed_key, connect_node_num, value))
+  if (!louds_dense_->lookupKey(key, connect_node_num, value))
     return false;
-  else if (connect_node_num != 0)
-    return louds_sparse_->lookupKey(transformed_key, connect_node_num, value);
+  // without dense levels the walk starts at the sparse root, node 0
+  else if (connect_node_num != 0 || louds_dense_->getHeight() == 0)
+    return louds_sparse_->lookupKey(key, connect_node_num, value);
   return true;
 }
 
-bool FST::lookupKey(const std::string &key, uint64_t &value) const {
+bool FST::erase(std::string_view key) {
   position_t connect_node_num = 0;
-  if (!louds_dense_->lookupKey(key, connect_node_num, value))
+  if (!louds_dense_->eraseKey(key, connect_node_num))
     return false;
-  else if (connect_node_num != 0)
-    return louds_sparse_->lookupKey(key, connect_node_num, value);
+  else if (connect_node_num != 0 || louds_dense_->getHeight() == 0)
+    return louds_sparse_->eraseKey(key, connect_node_num);
   return true;
 }
 
+void FST::lookupKeys(const std::string *keys, const size_t n, uint64_t *values,
+                     bool *found) const {
+  for (size_t first = 0; first < n; first += kLookupBatchSize) {
+    lookupKeyGroup(keys, first, std::min<size_t>(kLookupBatchSize, n - first),
+                   values, found);
+  }
+}
+
+void FST::lookupKeys(const std::string_view *keys, const size_t n,
+                     uint64_t *values, bool *found) const {
+  for (size_t first = 0; first < n; first += kLookupBatchSize) {
+    lookupKeyGroup(keys, first, std::min<size_t>(kLookupBatchSize, n - first),
+                   values, found);
+  }
+}
+
+template <typename Key>
+void FST::lookupKeyGroup(const Key *keys, const size_t first,
+                         const size_t count, uint64_t *values,
+                         bool *found) const {
+  BatchLookupState active[kLookupBatchSize];
+  // values are prefetched when the lookup terminates and read at the end
+  BatchLookupState dense_hits[kLookupBatchSize];
+  BatchLookupState sparse_hits[kLookupBatchSize];
+  size_t num_active = 0;
+  size_t num_dense_hits = 0;
+  size_t num_sparse_hits = 0;
+
+  for (size_t idx = first; idx < first + count; idx++) {
+    found[idx] = false;
+    if (!keys[idx].empty()) active[num_active++] = {idx, 0, 0};
+  }
+
+  const level_t dense_height = louds_dense_->getHeight();
+  for (level_t level = 0; num_active > 0; level++) {
+    size_t num_remaining = 0;
+    position_t value_pos = 0;
+
+    if (level < dense_height) {
+      for (size_t i = 0; i < num_active; i++)
+        louds_dense_->prefetchStep(active[i].node_num,
+                                   (label_t) keys[active[i].idx][level]);
+
+      for (size_t i = 0; i < num_active; i++) {
+        BatchLookupState &state = active[i];
+        std::string_view key = keys[state.idx];
+        switch (louds_dense_->step((label_t) key[level], state.node_num,
+                                   value_pos)) {
+          case StepResult::kValue:
+            louds_dense_->prefetchValue(value_pos);
+            dense_hits[num_dense_hits++] = {state.idx, level, value_pos};
+            break;
+          case StepResult::kChild:
+            // stays active unless key runs out of bytes
+            if (level + 1 < key.length()) active[num_remaining++] = state;
+            break;
+          case StepResult::kMiss:
+            break;
+        }
+      }
+    } else {
+      for (size_t i = 0; i < num_active; i++)
+        louds_sparse_->prefetchSelectSample(active[i].node_num);
+      for (size_t i = 0; i < num_active; i++)
+        louds_sparse_->prefetchSelectWord(active[i].node_num);
+      for (size_t i = 0; i < num_active; i++)
+        active[i].pos = louds_sparse_->prefetchNode(active[i].node_num);
+
+      for (size_t i = 0; i < num_active; i++) {
+        BatchLookupState &state = active[i];
+        std::string_view key = keys[state.idx];
+        switch (louds_sparse_->step((label_t) key[level], state.pos,
+                                    state.node_num, value_pos)) {
+          case StepResult::kValue:
+            louds_sparse_->prefetchValue(value_pos);
+            sparse_hits[num_sparse_hits++] = {state.idx, level, value_pos};
+            break;
+          case StepResult::kChild:
+            // stays active unless key runs out of bytes
+            if (level + 1 < key.length()) active[num_remaining++] = state;
+            break;
+          case StepResult::kMiss:
+            break;
+        }
+      }
+    }
+    num_active = num_remaining;
+  }
+
+  for (size_t i = 0; i < num_dense_hits; i++) {
+    const BatchLookupState &hit = dense_hits[i];
+    if (louds_dense_->compareSuffix(hit.pos, keys[hit.idx], hit.node_num) != 0 ||
+        louds_dense_->isErased(hit.pos))
+      continue;
+    values[hit.idx] = louds_dense_->getValue(hit.pos);
+    found[hit.idx] = true;
+  }
+  for (size_t i = 0; i < num_sparse_hits; i++) {
+    const BatchLookupState &hit = sparse_hits[i];
+    if (louds_sparse_->compareSuffix(hit.pos, keys[hit.idx], hit.node_num) != 0 ||
+        louds_sparse_->isErased(hit.pos))
+      continue;
+    values[hit.idx] = louds_sparse_->getValue(hit.pos);
+    found[hit.idx] = true;
+  }
+}
+
+void FST::lookupSorted(const uint64_t *keys, const size_t n,
+                       uint64_t *values, bool *found) const {
+  lookupSortedIntegers(keys, n, values, found);
+}
+
+template <typename T>
+void FST::lookupSortedIntegers(const T *keys, const size_t n,
+                               uint64_t *values, bool *found) const {
+  constexpr level_t kNumLevels = sizeof(T);
+  const level_t dense_height = louds_dense_->getHeight();
+  // the path of the previous key: the node it stepped through on each
+  // level and, on sparse levels, the position of the node's first label
+  position_t node_nums[kNumLevels];
+  position_t label_pos[kNumLevels];
+  node_nums[0] = 0;
+  if (dense_height == 0) label_pos[0] = louds_sparse_->prefetchNode(0);
+  // level, result and value position of the last step of the previous key
+  level_t end_level = 0;
+  StepResult end_result = StepResult::kMiss;
+  position_t value_pos = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    const T key = keys[i];
+    level_t level = 0;
+    if (i > 0) {
+      if (key == keys[i - 1]) {
+        // values of misses are not written
+        if (found[i - 1]) values[i] = values[i - 1];
+        found[i] = found[i - 1];
+        continue;
+      }
+      level = commonPrefixBytes(keys[i - 1], key, kNumLevels);
+    }
+
+    // If the previous key ended above the shared prefix, this key ends in
+    // the same step. Otherwise the walk resumes on the first level whose
+    // label differs.
+    if (level <= end_level) {
+      for (; level < kNumLevels; level++) {
+        const label_t label = (label_t) (key >> (8 * (kNumLevels - 1 - level)));
+        position_t node_num = node_nums[level];
+        end_result = level < dense_height
+            ? louds_dense_->step(label, node_num, value_pos)
+            : louds_sparse_->step(label, label_pos[level], node_num, value_pos);
+        if (end_result != StepResult::kChild || level + 1 == kNumLevels) break;
+        node_nums[level + 1] = node_num;
+        if (level + 1 >= dense_height)
+          label_pos[level + 1] = louds_sparse_->prefetchNode(node_num);
+      }
+      end_level = level;
+      // all keys have kNumLevels bytes, the last level only holds leaves
+      if (end_result == StepResult::kChild) end_result = StepResult::kMiss;
+    }
+
+    found[i] = false;
+    if (end_result == StepResult::kMiss) continue;
+    T swapped_key;
+    if constexpr (sizeof(T) == 4)
+      swapped_key = __builtin_bswap32(key);
+    else
+      swapped_key = __builtin_bswap64(key);
+    const std::string_view key_bytes(reinterpret_cast<const char *>(&swapped_key),
+                                     kNumLevels);
+    if (end_level < dense_height) {
+      values[i] = louds_dense_->getValue(value_pos);
+      found[i] = louds_dense_->compareSuffix(value_pos, key_bytes, end_level) == 0 &&
+          !louds_dense_->isErased(value_pos);
+    } else {
+      values[i] = louds_sparse_->getValue(value_pos);
+      found[i] = louds_sparse_->compareSuffix(value_pos, key_bytes, end_level) == 0 &&
+          !louds_sparse_->isErased(value_pos);
+    }
+  }
+}
+
 uint64_t FST::lookupNodeNum(const char *key, uint64_t key_length) const {
   position_t node_num = 0;
   if (louds_dense_->lookupNodeNumber(key, key_length, node_num))
@@ -322,7 +802,7 @@ void FST::moveToLeftmostKeyStartingAtNode(level_t level, size_t node_number, FST
 
 FST::Iter FST::moveToKeyStartingAtNode(level_t &level,
                                        size_t node_number,
-                                       const std::string &key) const {
+                                       std::string_view key) const {
   FST::Iter iter(this);
 
   if (level < getSparseStartLevel()) { // starting in dense part
@@ -351,30 +831,125 @@ FST::Iter FST::moveToKeyStartingAtNode(level_t &level,
   throw;  // shouldn't reach here
 };
 
-FST::Iter FST::moveToKeyGreaterThan(const std::string &key, const bool inclusive) const {
-  FST::Iter iter(this);
-  // todo do not move iterator,
-  louds_dense_->moveToKeyGreaterThan(key, inclusive, iter.dense_iter_);
+FST::Cursor::Cursor(const FST *fst, const level_t level,
+                    const position_t node_num)
+    : fst_(fst), level_(level), node_num_(node_num) {
+  is_dense_ = level_ < fst_->louds_dense_->getHeight();
+  if (!is_dense_) pos_ = fst_->louds_sparse_->getNodeStart(node_num_);
+}
 
-  if (!iter.dense_iter_.isValid()) return iter;
-  if (iter.dense_iter_.isComplete()) return iter;
+bool FST::Cursor::step(const label_t label) {
+  assert(isValid() && !isAtValue());
+  position_t node_num = node_num_;
+  state_ = is_dense_ ? fst_->louds_dense_->step(label, node_num, value_pos_)
+                     : fst_->louds_sparse_->step(label, pos_, node_num, value_pos_);
+  if (state_ == StepResult::kMiss) return false;
+  level_++;
+  if (state_ == StepResult::kChild) {
+    node_num_ = node_num;
+    is_dense_ = level_ < fst_->louds_dense_->getHeight();
+    if (!is_dense_) pos_ = fst_->louds_sparse_->getNodeStart(node_num_);
+  }
+  return true;
+}
 
-  if (!iter.dense_iter_.isSearchComplete()) {
-    iter.passToSparse();
-    louds_sparse_->moveToKeyGreaterThan(key, inclusive, iter.sparse_iter_);
-    if (!iter.sparse_iter_.isValid()) iter.incrementDenseIter();
-    return iter;
-  } else if (!iter.dense_iter_.isMoveLeftComplete()) {
-    iter.passToSparse();
-    iter.sparse_iter_.moveToLeftMostKey();
-    return iter;
+bool FST::Cursor::descend(const std::string_view prefix) {
+  for (const char c : prefix) {
+    if (isAtValue()) return true;
+    if (!step((label_t) c)) return false;
+  }
+  return true;
+}
+
+uint64_t FST::Cursor::value() const {
+  assert(isAtValue());
+  return is_dense_ ? fst_->louds_dense_->getValue(value_pos_)
+                   : fst_->louds_sparse_->getValue(value_pos_);
+}
+
+bool FST::Cursor::lookupKey(const std::string_view key, uint64_t &value) const {
+  assert(isValid() && key.length() >= level_);
+  const LoudsDense &dense = *fst_->louds_dense_;
+  const LoudsSparse &sparse = *fst_->louds_sparse_;
+  position_t node_num = node_num_;
+  position_t value_pos = value_pos_;
+  StepResult result = state_;
+  // the level of the last label
+  level_t level = level_ - 1;
+  if (result == StepResult::kChild) {
+    const level_t dense_height = dense.getHeight();
+    for (level = level_; level < dense_height; level++) {
+      if (level >= key.length()) return false;
+      result = dense.step((label_t) key[level], node_num, value_pos);
+      if (result != StepResult::kChild) break;
+    }
+    if (level >= dense_height) {
+      for (; level < key.length(); level++) {
+        // the position of the first label is known for the cursor's node
+        result = level == level_
+            ? sparse.step((label_t) key[level], pos_, node_num, value_pos)
+            : sparse.step((label_t) key[level], node_num, value_pos);
+        if (result != StepResult::kChild) break;
+      }
+      if (result == StepResult::kChild) return false;  // key ran out of bytes
+    }
+    if (result == StepResult::kMiss) return false;
+  }
+
+  if (level < dense.getHeight()) {
+    value = dense.getValue(value_pos);
+    return dense.compareSuffix(value_pos, key, level) == 0 &&
+        !dense.isErased(value_pos);
   }
+  value = sparse.getValue(value_pos);
+  return sparse.compareSuffix(value_pos, key, level) == 0 &&
+      !sparse.isErased(value_pos);
+}
+
+FST::Iter FST::Cursor::seekGE(const std::string_view key) const {
+  assert(isValid() && !isAtValue());
+  level_t level = level_;
+  FST::Iter iter = fst_->moveToKeyStartingAtNode(level, node_num_, key);
+  iter.skipErased();
+  return iter;
+}
 
-  assert(false);  // shouldn't reach here
+FST::Iter FST::moveToKeyGreaterThan(std::string_view key, const bool inclusive) const {
+  FST::Iter iter(this);
+  seek(iter, key, inclusive);
   return iter;
 }
 
-FST::Iter FST::moveToKeyLessThan(const std::string &key, const bool inclusive) const {
+void FST::seek(FST::Iter &iter, std::string_view key, const bool inclusive) const {
+  // levels of the current path that are also on the path of key
+  level_t dense_levels = 0;
+  level_t sparse_levels = 0;
+  if (iter.isValid()) {
+    dense_levels = iter.dense_iter_.commonPathLength(key);
+    // the sparse path starts where the dense path ends
+    if (dense_levels == louds_dense_->getHeight() && !iter.dense_iter_.isComplete())
+      sparse_levels = iter.sparse_iter_.commonPathLength(key);
+  }
+  iter.dense_iter_.truncate(dense_levels);
+  iter.sparse_iter_.truncate(sparse_levels);
+
+  louds_dense_->resumeMoveToKeyGreaterThan(key, inclusive, iter.dense_iter_);
+
+  if (iter.dense_iter_.isValid() && !iter.dense_iter_.isComplete()) {
+    if (!iter.dense_iter_.isSearchComplete()) {
+      iter.passToSparse();
+      louds_sparse_->resumeMoveToKeyGreaterThan(key, inclusive, iter.sparse_iter_);
+      if (!iter.sparse_iter_.isValid()) iter.incrementDenseIter();
+    } else {
+      assert(!iter.dense_iter_.isMoveLeftComplete());
+      iter.passToSparse();
+      iter.sparse_iter_.moveToLeftMostKey();
+    }
+  }
+  iter.skipErased();
+}
+
+FST::Iter FST::moveToKeyLessThan(std::string_view key, const bool inclusive) const {
   FST::Iter iter = moveToKeyGreaterThan(key, false);
   if (!iter.isValid()) {
     iter = moveToLast();
@@ -393,13 +968,16 @@ FST::Iter FST::moveToFirst() const {
   if (louds_dense_->getHeight() > 0) {
     iter.dense_iter_.setToFirstLabelInRoot();
     iter.dense_iter_.moveToLeftMostKey();
-    if (iter.dense_iter_.isMoveLeftComplete()) return iter;
-    iter.passToSparse();
-    iter.sparse_iter_.moveToLeftMostKey();
+    if (!iter.dense_iter_.isMoveLeftComplete()) {
+      iter.passToSparse();
+      iter.sparse_iter_.moveToLeftMostKey();
+    }
   } else {
+    iter.dense_iter_.skip();  // there are no dense levels
     iter.sparse_iter_.setToFirstLabelInRoot();
     iter.sparse_iter_.moveToLeftMostKey();
   }
+  iter.skipErased();
   return iter;
 }
 
@@ -408,18 +986,21 @@ FST::Iter FST::moveToLast() const {
   if (louds_dense_->getHeight() > 0) {
     iter.dense_iter_.setToLastLabelInRoot();
     iter.dense_iter_.moveToRightMostKey();
-    if (iter.dense_iter_.isMoveRightComplete()) return iter;
-    iter.passToSparse();
-    iter.sparse_iter_.moveToRightMostKey();
+    if (!iter.dense_iter_.isMoveRightComplete()) {
+      iter.passToSparse();
+      iter.sparse_iter_.moveToRightMostKey();
+    }
   } else {
+    iter.dense_iter_.skip();  // there are no dense levels
     iter.sparse_iter_.setToLastLabelInRoot();
     iter.sparse_iter_.moveToRightMostKey();
   }
+  iter.skipErasedBackward();
   return iter;
 }
 
-std::pair<FST::Iter, FST::Iter> FST::lookupRange(const std::string &left_key, const bool left_inclusive,
-                                                 const std::string &right_key, const bool right_inclusive) {
+std::pair<FST::Iter, FST::Iter> FST::lookupRange(std::string_view left_key, const bool left_inclusive,
+                                                 std::string_view right_key, const bool right_inclusive) {
   auto begin_iter = moveToKeyGreaterThan(left_key, left_inclusive);
   auto end_iter = moveToKeyGreaterThan(right_key, true);
 
@@ -443,6 +1024,240 @@ std::pair<FST::Iter, FST::Iter> FST::lookupRange(const std::string &left_key, co
   return {begin_iter, end_iter};
 }
 
+uint64_t FST::rankOf(std::string_view key) const {
+  position_t node_num = 0;
+  position_t level_node_num = 0;
+  bool on_path = true;
+  uint64_t rank = louds_dense_->rankKey(key, node_num, level_node_num, on_path);
+  return rank + louds_sparse_->rankKey(key, node_num, level_node_num, on_path);
+}
+
+uint64_t FST::countRange(std::string_view left,
+                         std::string_view right) const {
+  if (right <= left) return 0;
+  return rankOf(right) - rankOf(left);
+}
+
+FST::Iter FST::atOrdinal(const uint64_t ordinal) const {
+  if (ordinal >= getNumKeys()) return FST::Iter(this);
+
+  std::string prefix;
+  uint64_t remaining = ordinal;
+  position_t node_num = 0;
+  auto sparse_keys_in_range = [this](const position_t begin_node_num,
+                                     const position_t end_node_num) {
+    return louds_sparse_->countKeysInRange(
+        louds_sparse_->getStartLevel(),
+        louds_sparse_->getNodeStart(begin_node_num),
+        louds_sparse_->getNodeStart(end_node_num));
+  };
+  if (!louds_dense_->selectKey(remaining, prefix, node_num, sparse_keys_in_range))
+    louds_sparse_->selectKey(remaining, node_num, prefix);
+  // prefix is the unique prefix of the key
+  return moveToKeyGreaterThan(prefix, true);
+}
+
+std::vector<std::pair<std::string, std::string>> FST::partitionRange(
+    std::string_view left, std::string_view right, const size_t k) const {
+  std::vector<std::pair<std::string, std::string>> ranges;
+  if (k == 0) return ranges;
+  if (right <= left) {
+    ranges.assign(k, {std::string(left), std::string(left)});
+    return ranges;
+  }
+
+  const uint64_t first = rankOf(left);
+  const uint64_t last = rankOf(right);
+  std::string begin(left);
+  for (size_t i = 1; i < k; i++) {
+    const uint64_t ordinal = first + (last - first) * i / k;
+    std::string end = begin;
+    if (ordinal == last)
+      end = right;
+    else if (ordinal > first)
+      end = atOrdinal(ordinal).getFullKey();
+    ranges.emplace_back(begin, end);
+    begin = end;
+  }
+  ranges.emplace_back(begin, right);
+  return ranges;
+}
+
+size_t FST::scanParallel(std::string_view left, std::string_view right,
+                         const std::vector<ScanSink *> &sinks) const {
+  const auto ranges = partitionRange(left, right, sinks.size());
+  std::vector<size_t> num_keys(ranges.size());
+  std::atomic<size_t> next_range(0);
+  auto scan_ranges = [&]() {
+    for (size_t i = next_range++; i < ranges.size(); i = next_range++)
+      num_keys[i] = scan(ranges[i].first, ranges[i].second, SIZE_MAX, *sinks[i]);
+  };
+  // hardware_concurrency may be 0 if it is unknown
+  const size_t num_threads = std::min<size_t>(
+      ranges.size(), std::max(1u, std::thread::hardware_concurrency()));
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < num_threads; t++) threads.emplace_back(scan_ranges);
+  // the calling thread scans as well
+  scan_ranges();
+  for (auto &thread : threads) thread.join();
+
+  size_t total = 0;
+  for (const size_t n : num_keys) total += n;
+  return total;
+}
+
+template <typename Resolver>
+std::unique_ptr<FST> FST::merge(const FST &a, const FST &b, Resolver resolve) {
+  // without suffixes, the iterators only see the unique prefixes
+  if (!a.hasSuffixes() || !b.hasSuffixes())
+    throw std::invalid_argument("FST::merge: the inputs must store suffixes");
+  FSTBuilder builder(kIncludeDense, kSparseDenseRatio, true);
+  FST::Iter iter_a = a.moveToFirst();
+  FST::Iter iter_b = b.moveToFirst();
+  // complete keys of iter_a and iter_b
+  std::string key_a;
+  std::string key_b;
+  auto load_key = [](const FST::Iter &iter, std::string &key) {
+    if (iter.isValid()) key = iter.getFullKey();
+  };
+  load_key(iter_a, key_a);
+  load_key(iter_b, key_b);
+
+  bool is_empty = true;
+  while (iter_a.isValid() || iter_b.isValid()) {
+    const int cmp = !iter_a.isValid() ? 1 : !iter_b.isValid() ? -1 : key_a.compare(key_b);
+    if (cmp < 0) {
+      builder.add(key_a, iter_a.getValue());
+    } else if (cmp > 0) {
+      builder.add(key_b, iter_b.getValue());
+    } else {
+      builder.add(key_a, resolve(std::string_view(key_a), iter_a.getValue(),
+                                 iter_b.getValue()));
+    }
+    is_empty = false;
+    if (cmp <= 0) {
+      iter_a++;
+      load_key(iter_a, key_a);
+    }
+    if (cmp >= 0) {
+      iter_b++;
+      load_key(iter_b, key_b);
+    }
+  }
+  if (is_empty) return nullptr;
+  builder.finish();
+  return std::make_unique<FST>(builder);
+}
+
+size_t FST::scan(std::string_view left, std::string_view right,
+                 const size_t limit, ScanSink &sink) const {
+  if (left >= right) return 0;
+  FST::Iter iter = left.empty() ? moveToFirst() : moveToKeyGreaterThan(left, true);
+  const bool has_suffixes = hasSuffixes();
+  // compares the key in pieces, without assembling it
+  auto is_before_right = [&]() {
+    const std::string_view prefix = iter.keyView();
+    const int cmp = prefix.compare(right.substr(0, prefix.size()));
+    if (cmp != 0 || prefix.size() >= right.size()) return cmp < 0;
+    return has_suffixes && iter.getSuffix() < right.substr(prefix.size());
+  };
+
+  const bool with_keys = sink.wantsKeys();
+  uint64_t values[kScanBlockSize];
+  uint32_t key_offsets[kScanBlockSize + 1];
+  std::string key_bytes;
+  key_offsets[0] = 0;
+
+  size_t num_keys = 0;
+  size_t num_in_block = 0;
+  for (; num_keys < limit && iter.isValid() && is_before_right(); num_keys++, iter++) {
+    values[num_in_block] = iter.getValue();
+    if (with_keys) {
+      key_bytes.append(iter.keyView());
+      key_bytes.append(iter.getSuffix());
+      key_offsets[num_in_block + 1] = key_bytes.size();
+    }
+    if (++num_in_block == kScanBlockSize) {
+      sink.consume(values, with_keys ? key_bytes.data() : nullptr,
+                   with_keys ? key_offsets : nullptr, num_in_block);
+      key_bytes.clear();
+      num_in_block = 0;
+    }
+  }
+  if (num_in_block > 0)
+    sink.consume(values, with_keys ? key_bytes.data() : nullptr,
+                 with_keys ? key_offsets : nullptr, num_in_block);
+  return num_keys;
+}
+
+void FST::writeTo(const std::string &path) const {
+  // the payload is serialized into a cache line aligned buffer, like the
+  // payload of the mapped file
+  const uint64_t size = serializedSize();
+  std::unique_ptr<char[]> buffer(new char[size + kCacheLineSize]());
+  char *payload = buffer.get() + (-reinterpret_cast<uintptr_t>(buffer.get()) % kCacheLineSize);
+  char *cur_data = payload;
+  louds_dense_->serialize(cur_data);
+  louds_sparse_->serialize(cur_data);
+  assert(cur_data - payload == (int64_t) size);
+
+  FileHeader header{};
+  memcpy(header.magic, kFileMagic, sizeof(header.magic));
+  header.version = kFileVersion;
+  header.flags = kFileFlags;
+  header.payload_size = size;
+  header.checksum = Hash(payload, size, kFileChecksumSeed);
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(payload, size);
+  out.close();
+  if (!out) throw std::runtime_error("FST: cannot write " + path);
+}
+
+std::unique_ptr<FST> FST::open(const std::string &path,
+                               const bool verify_checksum) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("FST: cannot open " + path);
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0) {
+    ::close(fd);
+    throw std::runtime_error("FST: cannot stat " + path);
+  }
+  const auto file_size = static_cast<size_t>(file_stat.st_size);
+  if (file_size < sizeof(FileHeader)) {
+    ::close(fd);
+    throw std::runtime_error("FST: " + path + " is not an FST file");
+  }
+  void *data = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) throw std::runtime_error("FST: cannot map " + path);
+
+  // from here on, the destructor releases the mapping
+  std::unique_ptr<FST> fst = std::make_unique<FST>();
+  fst->mapped_data_ = data;
+  fst->mapped_size_ = file_size;
+
+  const auto *header = static_cast<const FileHeader *>(data);
+  char *payload = static_cast<char *>(data) + sizeof(FileHeader);
+  if (memcmp(header->magic, kFileMagic, sizeof(kFileMagic)) != 0)
+    throw std::runtime_error("FST: " + path + " is not an FST file");
+  if (header->version != kFileVersion)
+    throw std::runtime_error("FST: unsupported format version in " + path);
+  if (header->payload_size != file_size - sizeof(FileHeader))
+    throw std::runtime_error("FST: corrupt header in " + path);
+  if (header->flags != kFileFlags)
+    throw std::runtime_error("FST: " + path + " was written with different build options");
+  if (verify_checksum &&
+      header->checksum != Hash(payload, header->payload_size, kFileChecksumSeed))
+    throw std::runtime_error("FST: checksum mismatch in " + path);
+
+  fst->louds_dense_ = LoudsDense::deSerialize(payload);
+  fst->louds_sparse_ = LoudsSparse::deSerialize(payload);
+  fst->iter_ = FST::Iter(fst.get());
+  return fst;
+}
+
 uint64_t FST::serializedSize() const { return (louds_dense_->serializedSize() + louds_sparse_->serializedSize()); }
 
 uint64_t FST::getMemoryUsage() const {
@@ -453,6 +1268,10 @@ level_t FST::getHeight() const { return louds_sparse_->getHeight(); }
 
 level_t FST::getSparseStartLevel() const { return louds_sparse_->getStartLevel(); }
 
+uint64_t FST::getNumKeys() const {
+  return louds_dense_->getNumKeys() + louds_sparse_->getNumKeys();
+}
+
 //============================================================================
 
 void FST::Iter::clear() {
@@ -464,7 +1283,7 @@ bool FST::Iter::isValid() const {
   return dense_iter_.isValid() && (dense_iter_.isComplete() || sparse_iter_.isValid());
 }
 
-int FST::Iter::compare(const std::string &key) const {
+int FST::Iter::compare(std::string_view key) const {
   assert(isValid());
   int dense_compare = dense_iter_.compare(key);
   if (dense_iter_.isComplete() || dense_compare != 0) return dense_compare;
@@ -476,13 +1295,44 @@ uint64_t FST::Iter::getValue() const {
   return sparse_iter_.getValue();
 }
 
-std::string FST::Iter::getKey() const {
-  if (!isValid()) return std::string();
-  if (dense_iter_.isComplete()) return dense_iter_.getKey();
-  return dense_iter_.getKey() + sparse_iter_.getKey();
+std::string FST::Iter::getKey() const { return std::string(keyView()); }
+
+std::string_view FST::Iter::keyView() const {
+  if (!isValid()) return std::string_view();
+  if (dense_iter_.isComplete()) return dense_iter_.keyView();
+  // the dense key bytes were handed to the sparse iterator by passToSparse
+  return sparse_iter_.prefixedKeyView();
+}
+
+std::string_view FST::Iter::getSuffix() const {
+  if (!isValid()) return std::string_view();
+  return dense_iter_.isComplete() ? dense_iter_.getSuffix() : sparse_iter_.getSuffix();
 }
 
-void FST::Iter::passToSparse() { sparse_iter_.setStartNodeNum(dense_iter_.getSendOutNodeNum()); }
+std::string FST::Iter::getFullKey() const {
+  std::string key = getKey();
+  std::string_view suffix = getSuffix();
+  key.append(suffix.data(), suffix.size());
+  return key;
+}
+
+bool FST::Iter::isErased() const {
+  if (dense_iter_.isComplete()) return dense_iter_.isErased();
+  return sparse_iter_.isErased();
+}
+
+void FST::Iter::skipErased() {
+  if (isValid() && isErased()) (*this)++;
+}
+
+void FST::Iter::skipErasedBackward() {
+  if (isValid() && isErased()) (*this)--;
+}
+
+void FST::Iter::passToSparse() {
+  sparse_iter_.setStartNodeNum(dense_iter_.getSendOutNodeNum());
+  sparse_iter_.setPrefix(dense_iter_.keyView());
+}
 
 bool FST::Iter::incrementDenseIter() {
   if (!dense_iter_.isValid() || dense_iter_.isSkipped()) return false;
@@ -504,12 +1354,14 @@ bool FST::Iter::incrementSparseIter() {
 
 bool FST::Iter::operator++(int) {
   if (!isValid()) return false;
-  if (incrementSparseIter()) return true;
-  return incrementDenseIter();
+  do {
+    if (!incrementSparseIter() && !incrementDenseIter()) return false;
+  } while (isValid() && isErased());
+  return true;
 }
 
 bool FST::Iter::decrementDenseIter() {
-  if (!dense_iter_.isValid()) return false;
+  if (!dense_iter_.isValid() || dense_iter_.isSkipped()) return false;
 
   dense_iter_--;
   if (!dense_iter_.isValid()) return false;
@@ -528,8 +1380,10 @@ bool FST::Iter::decrementSparseIter() {
 
 bool FST::Iter::operator--(int) {
   if (!isValid()) return false;
-  if (decrementSparseIter()) return true;
-  return decrementDenseIter();
+  do {
+    if (!decrementSparseIter() && !decrementDenseIter()) return false;
+  } while (isValid() && isErased());
+  return true;
 }
 
 bool FST::Iter::operator!=(const FST::Iter &other) {
@@ -1,8 +1,14 @@
 #ifndef FSTBUILDER_H_
 #define FSTBUILDER_H_
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 #include "config.hpp"
@@ -13,9 +19,11 @@ namespace fst {
 class FSTBuilder {
  public:
   FSTBuilder() : sparse_start_level_(0) {};
-  explicit FSTBuilder(bool include_dense, uint32_t sparse_dense_ratio)
+  explicit FSTBuilder(bool include_dense, uint32_t sparse_dense_ratio,
+                      bool include_suffixes = kIncludeSuffixes)
       : include_dense_(include_dense),
         sparse_dense_ratio_(sparse_dense_ratio),
+        include_suffixes_(include_suffixes),
         sparse_start_level_(0) {};
 
   ~FSTBuilder() = default;
@@ -24,8 +32,26 @@ class FSTBuilder {
   // through a single scan of the sorted key list.
   // After build, the member vectors are used in FST constructor.
   // REQUIRED: provided key list must be sorted.
+  // With num_threads > 1, the LOUDS-Sparse vectors are built from up to
+  // num_threads partitions of the key list concurrently (see buildSparseParallel).
   void build(const std::vector<std::string> &keys,
-             const std::vector<uint64_t> &values);
+             const std::vector<uint64_t> &values,
+             unsigned num_threads = 1);
+
+  // Streaming alternative to build: keys are added one by one in sorted
+  // order and only the previous key is kept in the builder. Duplicate keys
+  // keep the value of their first occurrence. finish must be called after
+  // the last key has been added; it throws std::logic_error if no key was
+  // added, as a trie without keys cannot be built.
+  void add(std::string_view key, uint64_t value);
+
+  // Like add for the sizeof(T) big endian bytes of key. The common prefix
+  // with the neighbouring keys is the number of leading zero bytes of their
+  // XOR, so key bytes are never compared. Cannot be mixed with add.
+  template <typename T>
+  void addInteger(T key, uint64_t value);
+
+  void finish();
 
   static bool readBit(const std::vector<word_t> &bits, const position_t pos) {
     assert(pos < (bits.size() * kWordSize));
@@ -43,6 +69,24 @@ class FSTBuilder {
 
   level_t getTreeHeight() const { return labels_.size(); }
 
+  // encoding of the value vectors built from this builder
+  void setValueEncoding(ValueEncoding encoding) { value_encoding_ = encoding; }
+  ValueEncoding getValueEncoding() const { return value_encoding_; }
+
+  // How the first LOUDS-Sparse level is chosen when dense levels are
+  // included. kSizeRatio keeps the dense levels below 1/sparse_dense_ratio of
+  // the sparse size. kLookupCost models the cost of looking up every key
+  // once: the cache lines each level reads, weighting each node by the number
+  // of keys below it and its label search by the node's width, and whether
+  // the levels down to it fit into kCutoffCacheSize bytes. The cost is
+  // modelled, not measured. The cheapest cutoff is chosen among those whose
+  // trie is at most 1/sparse_dense_ratio larger than an all-sparse trie, or
+  // of any size if sparse_dense_ratio is 0. Wide nodes are smaller as bitmaps
+  // and move to LOUDS-Dense; levels of many narrow nodes stay sparse if
+  // their bitmaps would push the levels below out of the cache.
+  void setCutoffPolicy(CutoffPolicy policy) { cutoff_policy_ = policy; }
+  CutoffPolicy getCutoffPolicy() const { return cutoff_policy_; }
+
   // const accessors
   const std::vector<std::vector<word_t>> &getBitmapLabels() const {
     return bitmap_labels_;
@@ -64,19 +108,50 @@ class FSTBuilder {
   const std::vector<position_t> &getNodeCounts() const { return node_counts_; }
   level_t getSparseStartLevel() const { return sparse_start_level_; }
 
-  std::vector<uint64_t> getDenseValues() const { return values_dense_; }
+  const std::vector<uint64_t> &getDenseValues() const { return values_dense_; }
+
+  const std::vector<uint64_t> &getSparseValues() const { return values_sparse_; }
 
-  std::vector<uint64_t> getSparseValues() const { return values_sparse_; }
+  // suffix offsets are empty if suffixes are not included
+  const std::vector<position_t> &getDenseSuffixOffsets() const {
+    return suffix_offsets_dense_;
+  }
+  const std::vector<char> &getDenseSuffixBytes() const {
+    return suffix_bytes_dense_;
+  }
+  const std::vector<position_t> &getSparseSuffixOffsets() const {
+    return suffix_offsets_sparse_;
+  }
+  const std::vector<char> &getSparseSuffixBytes() const {
+    return suffix_bytes_sparse_;
+  }
 
  private:
-  static bool isSameKey(const std::string &a, const std::string &b) {
+  static bool isSameKey(const std::string_view a, const std::string_view b) {
     return a == b;
   }
 
   // Fill in the LOUDS-Sparse vectors through a single scan
-  // of the sorted key list.
+  // of the sorted keys in [begin, end).
   void buildSparse(const std::vector<std::string> &keys,
-                   const std::vector<uint64_t> &values);
+                   const std::vector<uint64_t> &values,
+                   position_t begin, position_t end);
+
+  // Splits the sorted key list at boundaries of the first key byte into
+  // up to num_threads partitions of similar size. Each partition is a set of
+  // subtries of the root, so its LOUDS-Sparse vectors are built independently
+  // and then appended level by level to the vectors of its left neighbours.
+  void buildSparseParallel(const std::vector<std::string> &keys,
+                           const std::vector<uint64_t> &values,
+                           unsigned num_threads);
+
+  // Appends the per-level vectors of the builder of the next key partition.
+  void appendPartition(const FSTBuilder &partition);
+
+  // Appends the first num_src_bits bits of src to bits, which holds num_bits.
+  static void appendBits(std::vector<word_t> &bits, position_t num_bits,
+                         const std::vector<word_t> &src,
+                         position_t num_src_bits);
 
   // Walks down the current partially-filled trie by comparing key to
   // its previous key in the list until their prefixes do not match.
@@ -84,32 +159,63 @@ class FSTBuilder {
   // label vector.
   // For each matching prefix byte(label), it sets the corresponding
   // child indicator bit to 1 for that label.
-  level_t skipCommonPrefix(const std::string &key);
+  level_t skipCommonPrefix(std::string_view key);
 
   // Starting at the start_level of the trie, the function inserts
   // key bytes to the trie vectors until the first byte/label where
   // key and next_key do not match.
   // This function is called after skipCommonPrefix. Therefore, it
   // guarantees that the stored prefix of key is unique in the trie.
-  level_t insertKeyBytesToTrieUntilUnique(const std::string &key,
+  level_t insertKeyBytesToTrieUntilUnique(std::string_view key,
                                           uint64_t position,
-                                          const std::string &next_key,
+                                          std::string_view next_key,
                                           level_t start_level);
 
+  // Inserts key[start_level, end_level) and stores value and the suffix
+  // of key at level end_level - 1.
+  void insertKeyBytes(std::string_view key, uint64_t value,
+                      level_t start_level, level_t end_level);
+
   inline bool isCharCommonPrefix(label_t c, level_t level) const;
   inline bool isLevelEmpty(level_t level) const;
   inline void moveToNextItemSlot(level_t level);
   void insertKeyByte(char c, level_t level,
                      bool is_start_of_node, bool is_term);
 
+  // Inserts the key held back by add now that its successor is known.
+  void insertPendingKey(std::string_view next_key);
+
+  // Inserts the key held back by addInteger. unique_length is the length
+  // of its prefix that is not shared with its successor, or 0 for the
+  // last key.
+  void insertPendingInteger(level_t unique_length);
+
+  // Builds the LOUDS-Dense vectors and distributes the values once all
+  // keys have been inserted into the LOUDS-Sparse vectors.
+  void finishLevels();
+
   // Compute sparse_start_level_ according to the pre-defined
   // size ratio between Sparse and Dense levels.
   // Dense size < Sparse size / sparse_dense_ratio_
   inline void determineCutoffLevel();
 
+  // the cutoff of CutoffPolicy::kLookupCost
+  level_t determineCutoffLevelByCost() const;
+
   inline uint64_t computeDenseMem(level_t downto_level) const;
   inline uint64_t computeSparseMem(level_t start_level) const;
 
+  // Moves the per-level values and suffixes to the dense and sparse
+  // vectors according to sparse_start_level_.
+  void splitValues();
+
+  void splitSuffixes(level_t begin_level, level_t end_level,
+                     std::vector<position_t> &offsets,
+                     std::vector<char> &bytes) const;
+
+  // Stores the bytes of key after its unique prefix of length level.
+  void insertSuffix(std::string_view key, level_t level);
+
   // Fill in the LOUDS-Dense vectors based on the built
   // Sparse vectors.
   // Called after sparse_start_level_ is set.
@@ -130,53 +236,237 @@ class FSTBuilder {
   // trie level >= sparse_start_level_: LOUDS-Sparse
   bool include_dense_{};
   uint32_t sparse_dense_ratio_{};
+  bool include_suffixes_{};
+  ValueEncoding value_encoding_{kValueEncoding};
+  CutoffPolicy cutoff_policy_{kCutoffPolicy};
   level_t sparse_start_level_;
 
   std::vector<std::vector<uint64_t>> values_;
+  // per level suffix bytes and lengths, in value order
+  std::vector<std::vector<char>> suffix_bytes_;
+  std::vector<std::vector<position_t>> suffix_lengths_;
 
   // LOUDS-Sparse bit/byte vectors
   std::vector<std::vector<label_t>> labels_;
   std::vector<std::vector<word_t>> child_indicator_bits_;
   std::vector<std::vector<word_t>> louds_bits_;
   std::vector<uint64_t> values_sparse_;
+  std::vector<position_t> suffix_offsets_sparse_;
+  std::vector<char> suffix_bytes_sparse_;
 
   // LOUDS-Dense bit vectors
   std::vector<std::vector<word_t>> bitmap_labels_;
   std::vector<std::vector<word_t>> bitmap_child_indicator_bits_;
   std::vector<std::vector<word_t>> prefixkey_indicator_bits_;
   std::vector<uint64_t> values_dense_;
+  std::vector<position_t> suffix_offsets_dense_;
+  std::vector<char> suffix_bytes_dense_;
 
   // auxiliary per level bookkeeping vectors
   std::vector<position_t> node_counts_;
   std::vector<bool> is_last_item_terminator_;
+
+  // last key passed to add; it is inserted once its successor is known
+  std::string pending_key_;
+  uint64_t pending_value_{};
+  bool has_pending_key_{};
+  // set instead of pending_key_ by addInteger
+  uint64_t pending_int_{};
+  level_t pending_int_width_{};  // sizeof the integer type, 0 for add
+  level_t pending_int_prefix_{};  // bytes shared with the previous key
 };
 
 void FSTBuilder::build(const std::vector<std::string> &keys,
-                       const std::vector<uint64_t> &values) {
+                       const std::vector<uint64_t> &values,
+                       const unsigned num_threads) {
   assert(keys.size() > 0);
-  buildSparse(keys, values);
+  if (num_threads > 1)
+    buildSparseParallel(keys, values, num_threads);
+  else
+    buildSparse(keys, values, 0, keys.size());
+  finishLevels();
+}
+
+void FSTBuilder::add(const std::string_view key, const uint64_t value) {
+  assert(pending_int_width_ == 0);
+  if (has_pending_key_) {
+    if (isSameKey(pending_key_, key)) return;
+    assert(std::string_view(pending_key_) < key);
+    insertPendingKey(key);
+  }
+  pending_key_.assign(key.data(), key.size());
+  pending_value_ = value;
+  has_pending_key_ = true;
+}
+
+template <typename T>
+void FSTBuilder::addInteger(const T key, const uint64_t value) {
+  static_assert(std::is_unsigned<T>::value && sizeof(T) <= sizeof(uint64_t),
+                "keys must be unsigned integers of at most 64 bits");
+  assert(!has_pending_key_ || pending_int_width_ == sizeof(T));
+  level_t prefix = 0;
+  if (has_pending_key_) {
+    if (pending_int_ == key) return;
+    assert(pending_int_ < key);
+    // the prefix shared with key ends the unique prefix of the pending key
+    prefix = commonPrefixBytes(pending_int_, key, sizeof(T));
+    insertPendingInteger(prefix + 1);
+  }
+  pending_int_ = key;
+  pending_int_width_ = sizeof(T);
+  pending_int_prefix_ = prefix;
+  pending_value_ = value;
+  has_pending_key_ = true;
+}
+
+void FSTBuilder::finish() {
+  if (!has_pending_key_)
+    throw std::logic_error("FSTBuilder: finish called without keys");
+  // for last key, there is no successor key
+  if (pending_int_width_ > 0)
+    insertPendingInteger(0);
+  else
+    insertPendingKey(std::string_view());
+  has_pending_key_ = false;
+  pending_int_width_ = 0;
+  pending_key_.clear();
+  pending_key_.shrink_to_fit();
+  finishLevels();
+}
+
+void FSTBuilder::insertPendingKey(const std::string_view next_key) {
+  level_t level = skipCommonPrefix(pending_key_);
+  insertKeyBytesToTrieUntilUnique(pending_key_, pending_value_, next_key,
+                                  level);
+}
+
+void FSTBuilder::insertPendingInteger(const level_t unique_length) {
+  // same as skipCommonPrefix: the shared bytes are the last labels of their
+  // levels and get a child
+  const level_t level = pending_int_prefix_;
+  for (level_t i = 0; i < level; i++)
+    setBit(child_indicator_bits_[i], getNumItems(i) - 1);
+
+  // big endian bytes of the key, the most significant byte first
+  const uint64_t swapped_key =
+      __builtin_bswap64(pending_int_ << (64 - 8 * pending_int_width_));
+  insertKeyBytes(std::string_view(reinterpret_cast<const char *>(&swapped_key),
+                                  pending_int_width_),
+                 pending_value_, level, std::max<level_t>(level + 1, unique_length));
+}
+
+void FSTBuilder::finishLevels() {
   if (include_dense_) {
     determineCutoffLevel();
     buildDense();
   }
+  splitValues();
 }
 
 void FSTBuilder::buildSparse(const std::vector<std::string> &keys,
-                             const std::vector<uint64_t> &values) {
-  for (position_t i = 0; i < keys.size(); i++) {
+                             const std::vector<uint64_t> &values,
+                             const position_t begin, const position_t end) {
+  for (position_t i = begin; i < end; i++) {
     level_t level = skipCommonPrefix(keys[i]);
     position_t curpos = i;
-    while ((i + 1 < keys.size()) && isSameKey(keys[curpos], keys[i + 1])) i++;
-    if (i < keys.size() - 1)
+    while ((i + 1 < end) && isSameKey(keys[curpos], keys[i + 1])) i++;
+    if (i < end - 1)
       insertKeyBytesToTrieUntilUnique(keys[curpos], values[curpos], keys[i + 1],
                                       level);
     else  // for last key, there is no successor key in the list
-      insertKeyBytesToTrieUntilUnique(keys[curpos], values[curpos], std::string(),
+      insertKeyBytesToTrieUntilUnique(keys[curpos], values[curpos], std::string_view(),
                                       level);
   }
 }
 
-level_t FSTBuilder::skipCommonPrefix(const std::string &key) {
+void FSTBuilder::buildSparseParallel(const std::vector<std::string> &keys,
+                                     const std::vector<uint64_t> &values,
+                                     const unsigned num_threads) {
+  // partition boundaries may only be placed between keys with different
+  // first bytes
+  std::vector<position_t> boundaries;
+  boundaries.push_back(0);
+  const position_t target_size = keys.size() / num_threads + 1;
+  for (position_t i = 1; i < keys.size(); i++) {
+    if ((i - boundaries.back() >= target_size) &&
+        keys[i][0] != keys[i - 1][0])
+      boundaries.push_back(i);
+  }
+  boundaries.push_back(keys.size());
+
+  const size_t num_partitions = boundaries.size() - 1;
+  if (num_partitions == 1) return buildSparse(keys, values, 0, keys.size());
+
+  std::vector<FSTBuilder> partitions(
+      num_partitions,
+      FSTBuilder(include_dense_, sparse_dense_ratio_, include_suffixes_));
+  std::vector<std::thread> threads;
+  for (size_t p = 1; p < num_partitions; p++) {
+    threads.emplace_back([&, p]() {
+      partitions[p].buildSparse(keys, values, boundaries[p], boundaries[p + 1]);
+    });
+  }
+  // the first partition is built into this builder directly
+  buildSparse(keys, values, boundaries[0], boundaries[1]);
+
+  for (size_t p = 1; p < num_partitions; p++) {
+    threads[p - 1].join();
+    appendPartition(partitions[p]);
+    partitions[p] = FSTBuilder();  // release the partition's vectors
+  }
+}
+
+void FSTBuilder::appendPartition(const FSTBuilder &partition) {
+  for (level_t level = 0; level < partition.getTreeHeight(); level++) {
+    if (level >= getTreeHeight()) addLevel();
+
+    const position_t num_items = getNumItems(level);
+    const position_t num_partition_items = partition.getNumItems(level);
+    appendBits(child_indicator_bits_[level], num_items,
+               partition.child_indicator_bits_[level], num_partition_items);
+    appendBits(louds_bits_[level], num_items, partition.louds_bits_[level],
+               num_partition_items);
+    labels_[level].insert(labels_[level].end(),
+                          partition.labels_[level].begin(),
+                          partition.labels_[level].end());
+    values_[level].insert(values_[level].end(),
+                          partition.values_[level].begin(),
+                          partition.values_[level].end());
+    suffix_bytes_[level].insert(suffix_bytes_[level].end(),
+                                partition.suffix_bytes_[level].begin(),
+                                partition.suffix_bytes_[level].end());
+    suffix_lengths_[level].insert(suffix_lengths_[level].end(),
+                                  partition.suffix_lengths_[level].begin(),
+                                  partition.suffix_lengths_[level].end());
+    node_counts_[level] += partition.node_counts_[level];
+    is_last_item_terminator_[level] = partition.is_last_item_terminator_[level];
+  }
+
+  // both partitions share the root node: the first root label of the
+  // appended partition does not start a new node
+  const position_t num_root_items =
+      getNumItems(0) - partition.getNumItems(0);
+  louds_bits_[0][num_root_items / kWordSize] &=
+      ~(kMsbMask >> (num_root_items % kWordSize));
+  node_counts_[0]--;
+}
+
+void FSTBuilder::appendBits(std::vector<word_t> &bits,
+                            const position_t num_bits,
+                            const std::vector<word_t> &src,
+                            const position_t num_src_bits) {
+  // keep the invariant that there is a free slot after the last bit
+  bits.resize((num_bits + num_src_bits) / kWordSize + 1, 0);
+  const position_t shift = num_bits % kWordSize;
+  const position_t word_id = num_bits / kWordSize;
+  for (position_t i = 0; i * kWordSize < num_src_bits; i++) {
+    bits[word_id + i] |= (src[i] >> shift);
+    if (shift > 0 && word_id + i + 1 < bits.size())
+      bits[word_id + i + 1] |= (src[i] << (kWordSize - shift));
+  }
+}
+
+level_t FSTBuilder::skipCommonPrefix(const std::string_view key) {
   level_t level = 0;
   while (level < key.length() &&
       isCharCommonPrefix((label_t) key[level], level)) {
@@ -187,41 +477,38 @@ level_t FSTBuilder::skipCommonPrefix(const std::string &key) {
 }
 
 level_t FSTBuilder::insertKeyBytesToTrieUntilUnique(
-    const std::string &key,
+    const std::string_view key,
     const uint64_t value,
-    const std::string &next_key,
+    const std::string_view next_key,
     const level_t start_level) {
   assert(start_level < key.length());
 
-  level_t level = start_level;
-  bool is_start_of_node = false;
-  bool is_term = false;
-  // If it is the start of level, the louds bit needs to be set.
-  if (isLevelEmpty(level)) {
-    is_start_of_node = true;
-  }
-
   // After skipping the common prefix, the first following byte
   // should be in the node as the previous key.
-  insertKeyByte(key[level], level, is_start_of_node, is_term);
-  level++;
-
-  if (level > next_key.length()
-      || !isSameKey(key.substr(0, level), next_key.substr(0, level))) {
-    values_[level - 1].emplace_back(value);
-    return level;
+  level_t level = start_level + 1;
+  if (level <= next_key.length()
+      && isSameKey(key.substr(0, level), next_key.substr(0, level))) {
+    while (level < key.length() && level < next_key.length()
+        && key[level - 1] == next_key[level - 1])
+      level++;
   }
+  insertKeyBytes(key, value, start_level, level);
+  return level;
+}
 
+void FSTBuilder::insertKeyBytes(const std::string_view key,
+                                const uint64_t value,
+                                const level_t start_level,
+                                const level_t end_level) {
+  assert(start_level < end_level && end_level <= key.length());
+  // If it is the start of level, the louds bit needs to be set.
+  insertKeyByte(key[start_level], start_level, isLevelEmpty(start_level),
+                false);
   // All the following bytes inserted must be the start of a new node.
-  is_start_of_node = true;
-
-  while (level < key.length() && level < next_key.length()
-      && key[level - 1] == next_key[level - 1]) {
-    insertKeyByte(key[level], level, is_start_of_node, is_term);
-    level++;
-  }
-  values_[level - 1].emplace_back(value);
-  return level;
+  for (level_t level = start_level + 1; level < end_level; level++)
+    insertKeyByte(key[level], level, true, false);
+  values_[end_level - 1].emplace_back(value);
+  insertSuffix(key, end_level);
 }
 
 inline bool FSTBuilder::isCharCommonPrefix(const label_t c,
@@ -266,6 +553,10 @@ void FSTBuilder::insertKeyByte(const char c, const level_t level,
 }
 
 inline void FSTBuilder::determineCutoffLevel() {
+  if (cutoff_policy_ == CutoffPolicy::kLookupCost) {
+    sparse_start_level_ = determineCutoffLevelByCost();
+    return;
+  }
   level_t cutoff_level = 0;
   uint64_t dense_mem = computeDenseMem(cutoff_level);
   uint64_t sparse_mem = computeSparseMem(cutoff_level);
@@ -277,7 +568,96 @@ inline void FSTBuilder::determineCutoffLevel() {
   }
   // cutoff_level = 3;
   sparse_start_level_ = cutoff_level--;
+}
+
+level_t FSTBuilder::determineCutoffLevelByCost() const {
+  const level_t height = getTreeHeight();
+  // cache lines read to look up every key once, per level in either encoding
+  std::vector<uint64_t> dense_cost(height, 0);
+  std::vector<uint64_t> sparse_cost(height, 0);
+  // number of keys below each node of the level, bottom up
+  std::vector<uint64_t> weights;
+  std::vector<uint64_t> child_weights;
+  for (level_t level = height; level-- > 0;) {
+    weights.clear();
+    position_t child = 0;
+    uint64_t weight = 0;
+    position_t node_size = 0;
+    for (position_t pos = 0; pos < getNumItems(level); pos++) {
+      if (pos > 0 && isStartOfNode(level, pos)) {
+        weights.push_back(weight);
+        sparse_cost[level] += weight * (kSparseStepCost + (node_size + 63) / 64);
+        weight = 0;
+        node_size = 0;
+      }
+      weight += readBit(child_indicator_bits_[level], pos)
+                    ? child_weights[child++] : 1;
+      node_size++;
+    }
+    weights.push_back(weight);
+    sparse_cost[level] += weight * (kSparseStepCost + (node_size + 63) / 64);
+    // every key below the level steps through it once
+    for (uint64_t node_weight : weights)
+      dense_cost[level] += node_weight * kDenseStepCost;
+    std::swap(weights, child_weights);
+  }
+
+  // in bytes: two bitmaps per dense node, a label and two bits per item
+  auto dense_bytes = [&](level_t level) {
+    return uint64_t(node_counts_[level]) * 2 * kFanout / 8;
+  };
+  auto sparse_bytes = [&](level_t level) {
+    return uint64_t(getNumItems(level)) * 10 / 8;
+  };
+  uint64_t sparse_mem = 0;
+  for (level_t level = 0; level < height; level++) sparse_mem += sparse_bytes(level);
+  // like for kSizeRatio, a ratio of 0 does not limit the dense levels
+  const uint64_t budget = sparse_dense_ratio_ == 0
+      ? std::numeric_limits<uint64_t>::max()
+      : sparse_mem + sparse_mem / sparse_dense_ratio_;
+
+  // Lookups go top down, so a level is modelled as cached as far as it and
+  // the levels above it fit into kCutoffCacheSize. The lines of the rest of
+  // the level miss the cache. Dense levels thus cost fewer lines, but may
+  // push the levels below them out of the cache.
+  auto lookup_cost = [&](const level_t cutoff_level) {
+    double cost = 0;
+    uint64_t mem_above = 0;
+    for (level_t level = 0; level < height; level++) {
+      const bool is_dense = level < cutoff_level;
+      const uint64_t mem = is_dense ? dense_bytes(level) : sparse_bytes(level);
+      double cached = 1;
+      if (mem_above >= kCutoffCacheSize)
+        cached = 0;
+      else if (mem_above + mem > kCutoffCacheSize)
+        cached = double(kCutoffCacheSize - mem_above) / mem;
+      const uint64_t lines = is_dense ? dense_cost[level] : sparse_cost[level];
+      cost += lines * (cached + (1 - cached) * kCacheMissCost);
+      mem_above += mem;
+    }
+    return cost;
+  };
+
+  level_t cutoff_level = 0;
+  double best_cost = lookup_cost(0);
+  uint64_t mem = sparse_mem;
+  uint64_t dense_nodes = 0;
+  for (level_t level = 0; level < height; level++) {
+    // the dense bitmaps are indexed by position_t
+    dense_nodes += node_counts_[level];
+    if (dense_nodes * kFanout > std::numeric_limits<position_t>::max()) break;
+    mem = mem + dense_bytes(level) - sparse_bytes(level);
+    if (mem > budget) continue;
+    const double cost = lookup_cost(level + 1);
+    if (cost < best_cost) {
+      best_cost = cost;
+      cutoff_level = level + 1;
+    }
+  }
+  return cutoff_level;
+}
 
+void FSTBuilder::splitValues() {
   // CA build dense and sparse values vectors
   for (uint64_t level = 0; level < sparse_start_level_; level++) {
     values_dense_.insert(values_dense_.end(), values_[level].begin(),
@@ -290,6 +670,41 @@ inline void FSTBuilder::determineCutoffLevel() {
                              values_[level].end());
   }
   values_.clear();
+
+  if (include_suffixes_) {
+    splitSuffixes(0, sparse_start_level_, suffix_offsets_dense_,
+                  suffix_bytes_dense_);
+    splitSuffixes(sparse_start_level_, suffix_lengths_.size(),
+                  suffix_offsets_sparse_, suffix_bytes_sparse_);
+  }
+  suffix_bytes_.clear();
+  suffix_lengths_.clear();
+}
+
+void FSTBuilder::splitSuffixes(const level_t begin_level,
+                               const level_t end_level,
+                               std::vector<position_t> &offsets,
+                               std::vector<char> &bytes) const {
+  uint64_t offset = 0;
+  offsets.push_back(offset);
+  for (level_t level = begin_level; level < end_level; level++) {
+    for (position_t length : suffix_lengths_[level]) {
+      offset += length;
+      // the offsets are positions, see FST_WIDE_POSITION
+      if (offset > std::numeric_limits<position_t>::max())
+        throw std::length_error("FSTBuilder: suffix bytes exceed position_t");
+      offsets.push_back(offset);
+    }
+    bytes.insert(bytes.end(), suffix_bytes_[level].begin(),
+                 suffix_bytes_[level].end());
+  }
+}
+
+void FSTBuilder::insertSuffix(const std::string_view key, const level_t level) {
+  if (!include_suffixes_) return;
+  suffix_bytes_[level - 1].insert(suffix_bytes_[level - 1].end(),
+                                  key.begin() + level, key.end());
+  suffix_lengths_[level - 1].push_back(key.length() - level);
 }
 
 inline uint64_t FSTBuilder::computeDenseMem(const level_t downto_level) const {
@@ -360,6 +775,8 @@ void FSTBuilder::setLabelAndChildIndicatorBitmap(const level_t level,
 void FSTBuilder::addLevel() {
   labels_.emplace_back(std::vector<label_t>());
   values_.emplace_back(std::vector<uint64_t>());
+  suffix_bytes_.emplace_back(std::vector<char>());
+  suffix_lengths_.emplace_back(std::vector<position_t>());
   child_indicator_bits_.emplace_back(std::vector<word_t>());
   louds_bits_.emplace_back(std::vector<word_t>());
 
@@ -0,0 +1,148 @@
+#ifndef INTFST_H_
+#define INTFST_H_
+
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "config.hpp"
+#include "fst.hpp"
+#include "fst_builder.hpp"
+
+namespace fst {
+
+// An FST of fixed width integer keys, stored as their big endian bytes like
+// the integer overloads of FST. It is built from the integers themselves
+// (FSTBuilder::addInteger), and a lookup walks at most sizeof(T) levels in
+// an unrolled loop that takes the labels from the integer by shifts.
+// Lookups and seeks do not allocate. The suffixes are always stored, so
+// lookups are exact.
+template <typename T>
+class IntFST {
+  static_assert(std::is_same<T, uint32_t>::value ||
+                    std::is_same<T, uint64_t>::value,
+                "IntFST keys are uint32_t or uint64_t");
+
+ public:
+  static constexpr level_t kNumLevels = sizeof(T);
+
+  //------------------------------------------------------------------
+  // Input keys must be SORTED
+  //------------------------------------------------------------------
+  IntFST(const std::vector<T> &keys, const std::vector<uint64_t> &values,
+         bool include_dense = kIncludeDense,
+         uint32_t sparse_dense_ratio = kSparseDenseRatio)
+      : fst_(build(keys, values, include_dense, sparse_dense_ratio)) {}
+
+  bool lookupKey(T key, uint64_t &value) const;
+
+  // see FST::lookupSorted
+  void lookupSorted(const T *keys, size_t n, uint64_t *values,
+                    bool *found) const {
+    fst_.lookupSortedIntegers(keys, n, values, found);
+  }
+
+  // see FST::erase
+  bool erase(T key) {
+    T buffer;
+    return fst_.erase(keyBytes(key, buffer));
+  }
+
+  FST::Iter moveToKeyGreaterThan(T key, bool inclusive) const {
+    T buffer;
+    return fst_.moveToKeyGreaterThan(keyBytes(key, buffer), inclusive);
+  }
+
+  FST::Iter moveToFirst() const { return fst_.moveToFirst(); }
+
+  FST::Iter moveToLast() const { return fst_.moveToLast(); }
+
+  // the integer key of a valid iterator of this FST
+  static T getKey(const FST::Iter &iter);
+
+  // the underlying trie, e.g. for serialization
+  const FST &getFST() const { return fst_; }
+
+  uint64_t getMemoryUsage() const { return fst_.getMemoryUsage(); }
+
+  uint64_t getNumKeys() const { return fst_.getNumKeys(); }
+
+ private:
+  static FSTBuilder build(const std::vector<T> &keys,
+                          const std::vector<uint64_t> &values,
+                          bool include_dense, uint32_t sparse_dense_ratio);
+
+  // views the big endian bytes of key, which are stored in buffer
+  static std::string_view keyBytes(const T key, T &buffer) {
+    if constexpr (sizeof(T) == 4)
+      buffer = __builtin_bswap32(key);
+    else
+      buffer = __builtin_bswap64(key);
+    return std::string_view(reinterpret_cast<const char *>(&buffer), sizeof(T));
+  }
+
+  static label_t labelAt(const T key, const level_t level) {
+    return (label_t) (key >> (8 * (kNumLevels - 1 - level)));
+  }
+
+  FST fst_;
+};
+
+template <typename T>
+FSTBuilder IntFST<T>::build(const std::vector<T> &keys,
+                            const std::vector<uint64_t> &values,
+                            const bool include_dense,
+                            const uint32_t sparse_dense_ratio) {
+  assert(keys.size() > 0 && keys.size() == values.size());
+  FSTBuilder builder(include_dense, sparse_dense_ratio, true);
+  for (size_t i = 0; i < keys.size(); i++) builder.addInteger(keys[i], values[i]);
+  builder.finish();
+  return builder;
+}
+
+template <typename T>
+T IntFST<T>::getKey(const FST::Iter &iter) {
+  assert(iter.isValid());
+  T key = 0;
+  for (const char c : iter.keyView()) key = (key << 8) | (label_t) c;
+  for (const char c : iter.getSuffix()) key = (key << 8) | (label_t) c;
+  return key;
+}
+
+template <typename T>
+bool IntFST<T>::lookupKey(const T key, uint64_t &value) const {
+  const LoudsDense &dense = *fst_.louds_dense_;
+  const LoudsSparse &sparse = *fst_.louds_sparse_;
+  const level_t dense_height = dense.getHeight();
+  position_t node_num = 0;
+  position_t value_pos = 0;
+  level_t level = 0;
+  // kNumLevels is a constant, the loop is unrolled completely
+  for (; level < kNumLevels; level++) {
+    const StepResult result =
+        level < dense_height
+            ? dense.step(labelAt(key, level), node_num, value_pos)
+            : sparse.step(labelAt(key, level), node_num, value_pos);
+    if (result == StepResult::kMiss) return false;
+    if (result == StepResult::kValue) break;
+  }
+  // all keys have kNumLevels bytes, the last level only holds leaves
+  if (level == kNumLevels) return false;
+
+  // the value is read before the suffix is compared, so that both loads
+  // overlap
+  T buffer;
+  const std::string_view bytes = keyBytes(key, buffer);
+  if (level < dense_height) {
+    value = dense.getValue(value_pos);
+    return dense.compareSuffix(value_pos, bytes, level) == 0 &&
+        !dense.isErased(value_pos);
+  }
+  value = sparse.getValue(value_pos);
+  return sparse.compareSuffix(value_pos, bytes, level) == 0 &&
+      !sparse.isErased(value_pos);
+}
+
+}  // namespace fst
+
+#endif  // INTFST_H_
@@ -0,0 +1,138 @@
+#ifndef ITERPATH_H_
+#define ITERPATH_H_
+
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+#include "config.hpp"
+
+namespace fst {
+
+// Per-level state of a trie iterator on the path to its current key: the
+// key byte, the position in the trie and the value position of every level.
+// Paths of up to kIterInlineHeight levels are stored inline, so that
+// creating, copying and clearing an iterator does not touch the heap; longer
+// paths use a single heap block.
+// Up to max_prefix_len bytes in front of the key bytes are reserved for the
+// key bytes of the levels above the iterator (see setPrefix), so that the
+// complete key can be viewed without copying it into a new string.
+class IterPath {
+ public:
+  IterPath() { clear(); }
+
+  IterPath(const level_t num_levels, const level_t max_prefix_len)
+      : num_levels_(num_levels), max_prefix_len_(max_prefix_len) {
+    if (!isInline()) heap_.reset(new char[bufferSize()]);
+    clear();
+  }
+
+  IterPath(const IterPath &other) { *this = other; }
+
+  IterPath(IterPath &&other) = default;
+
+  IterPath &operator=(const IterPath &other) {
+    if (this == &other) return *this;
+    if (!other.isInline() && (isInline() || bufferSize() != other.bufferSize()))
+      heap_.reset(new char[other.bufferSize()]);
+    num_levels_ = other.num_levels_;
+    max_prefix_len_ = other.max_prefix_len_;
+    prefix_len_ = other.prefix_len_;
+    memcpy(data(), other.data(), bufferSize());
+    return *this;
+  }
+
+  IterPath &operator=(IterPath &&other) = default;
+
+  void clear() {
+    memset(data(), 0, bufferSize());
+    prefix_len_ = 0;
+  }
+
+  // forgets the value positions, e.g. before a new seek
+  void clearValuePositions() {
+    memset(valuePositionsInitialized(), 0, levelCapacity() * sizeof(bool));
+  }
+
+  level_t numLevels() const { return num_levels_; }
+
+  label_t *keys() { return keyBytes() + max_prefix_len_; }
+  const label_t *keys() const { return keyBytes() + max_prefix_len_; }
+
+  position_t *positions() { return reinterpret_cast<position_t *>(data()); }
+  const position_t *positions() const {
+    return reinterpret_cast<const position_t *>(data());
+  }
+
+  position_t *valuePositions() { return positions() + levelCapacity(); }
+  const position_t *valuePositions() const {
+    return positions() + levelCapacity();
+  }
+
+  bool *valuePositionsInitialized() {
+    return reinterpret_cast<bool *>(keyBytes() + keyCapacity());
+  }
+
+  // Stores the key bytes of the levels above the iterator.
+  void setPrefix(std::string_view prefix) {
+    assert(prefix.size() <= max_prefix_len_);
+    prefix_len_ = prefix.size();
+    memcpy(keys() - prefix_len_, prefix.data(), prefix_len_);
+  }
+
+  // the first len key bytes
+  std::string_view keyView(level_t len) const {
+    return {reinterpret_cast<const char *>(keys()), len};
+  }
+
+  // the prefix followed by the first len key bytes
+  std::string_view prefixedKeyView(level_t len) const {
+    return {reinterpret_cast<const char *>(keys()) - prefix_len_,
+            prefix_len_ + len};
+  }
+
+ private:
+  bool isInline() const {
+    return num_levels_ + max_prefix_len_ <= kIterInlineHeight;
+  }
+
+  level_t levelCapacity() const {
+    return isInline() ? kIterInlineHeight : num_levels_;
+  }
+
+  level_t keyCapacity() const {
+    return isInline() ? kIterInlineHeight : num_levels_ + max_prefix_len_;
+  }
+
+  // positions, value positions, prefix and key bytes, initialized flags
+  size_t bufferSize() const {
+    return 2 * levelCapacity() * sizeof(position_t) + keyCapacity() +
+        levelCapacity() * sizeof(bool);
+  }
+
+  char *data() { return isInline() ? inline_ : heap_.get(); }
+  const char *data() const { return isInline() ? inline_ : heap_.get(); }
+
+  label_t *keyBytes() {
+    return reinterpret_cast<label_t *>(valuePositions() + levelCapacity());
+  }
+  const label_t *keyBytes() const {
+    return reinterpret_cast<const label_t *>(valuePositions() +
+        levelCapacity());
+  }
+
+  static const size_t kInlineSize =
+      kIterInlineHeight * (2 * sizeof(position_t) + sizeof(label_t) +
+          sizeof(bool));
+
+  level_t num_levels_ = 0;
+  level_t max_prefix_len_ = 0;
+  level_t prefix_len_ = 0;
+  std::unique_ptr<char[]> heap_;
+  alignas(sizeof(position_t)) char inline_[kInlineSize];
+};
+
+}  // namespace fst
+
+#endif  // ITERPATH_H_
@@ -1,27 +1,128 @@
 #ifndef LABELVECTOR_H_
 #define LABELVECTOR_H_
 
-#include <emmintrin.h>
+#include <immintrin.h>
+
+#include <algorithm>
 #include <vector>
 
 #include "config.hpp"
 
 namespace fst {
 
+// The SIMD label search kernels below read whole vectors starting inside
+// the searched node and rely on this many readable bytes after the last
+// label.
+static const position_t kLabelPadding = 64;
+
+enum class LabelSearchSimd : uint8_t { kSse2, kAvx2, kAvx512 };
+
+inline LabelSearchSimd detectLabelSearchSimd() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw")) return LabelSearchSimd::kAvx512;
+  if (__builtin_cpu_supports("avx2")) return LabelSearchSimd::kAvx2;
+  return LabelSearchSimd::kSse2;
+}
+
+// chosen once at startup
+static const LabelSearchSimd kLabelSearchSimd = detectLabelSearchSimd();
+
+// Each kernel returns the index of the first of the len labels that is
+// equal to (greater than) target, or len if there is none.
+inline position_t findEqualSse2(const label_t *labels, const label_t target,
+                                const position_t len) {
+  const __m128i targets = _mm_set1_epi8(target);
+  for (position_t i = 0; i < len; i += 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(labels + i));
+    const unsigned check_bits = _mm_movemask_epi8(_mm_cmpeq_epi8(targets, chunk));
+    if (check_bits) return std::min<position_t>(len, i + __builtin_ctz(check_bits));
+  }
+  return len;
+}
+
+// REQUIRED: target < 255
+inline position_t findGreaterSse2(const label_t *labels, const label_t target,
+                                  const position_t len) {
+  // x > target <=> max(x, target + 1) == x
+  const __m128i bounds = _mm_set1_epi8(target + 1);
+  for (position_t i = 0; i < len; i += 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(labels + i));
+    const unsigned check_bits = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_max_epu8(chunk, bounds), chunk));
+    if (check_bits) return std::min<position_t>(len, i + __builtin_ctz(check_bits));
+  }
+  return len;
+}
+
+__attribute__((target("avx2")))
+inline position_t findEqualAvx2(const label_t *labels, const label_t target,
+                                const position_t len) {
+  const __m256i targets = _mm256_set1_epi8(target);
+  for (position_t i = 0; i < len; i += 32) {
+    const __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(labels + i));
+    const unsigned check_bits =
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(targets, chunk));
+    if (check_bits) return std::min<position_t>(len, i + __builtin_ctz(check_bits));
+  }
+  return len;
+}
+
+__attribute__((target("avx2")))
+inline position_t findGreaterAvx2(const label_t *labels, const label_t target,
+                                  const position_t len) {
+  const __m256i bounds = _mm256_set1_epi8(target + 1);
+  for (position_t i = 0; i < len; i += 32) {
+    const __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(labels + i));
+    const unsigned check_bits = _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, bounds), chunk));
+    if (check_bits) return std::min<position_t>(len, i + __builtin_ctz(check_bits));
+  }
+  return len;
+}
+
+__attribute__((target("avx512bw")))
+inline position_t findEqualAvx512(const label_t *labels, const label_t target,
+                                  const position_t len) {
+  const __m512i targets = _mm512_set1_epi8(target);
+  for (position_t i = 0; i < len; i += 64) {
+    const __m512i chunk = _mm512_loadu_si512(labels + i);
+    const uint64_t check_bits = _mm512_cmpeq_epi8_mask(targets, chunk);
+    if (check_bits) return std::min<position_t>(len, i + __builtin_ctzll(check_bits));
+  }
+  return len;
+}
+
+__attribute__((target("avx512bw")))
+inline position_t findGreaterAvx512(const label_t *labels, const label_t target,
+                                    const position_t len) {
+  const __m512i targets = _mm512_set1_epi8(target);
+  for (position_t i = 0; i < len; i += 64) {
+    const __m512i chunk = _mm512_loadu_si512(labels + i);
+    const uint64_t check_bits = _mm512_cmpgt_epu8_mask(chunk, targets);
+    if (check_bits) return std::min<position_t>(len, i + __builtin_ctzll(check_bits));
+  }
+  return len;
+}
+
 class LabelVector {
  public:
-  LabelVector() : num_bytes_(0), labels_(nullptr){};
+  LabelVector() : num_bytes_(0), labels_(nullptr), owns_memory_(true){};
 
   explicit LabelVector(const std::vector<std::vector<label_t> > &labels_per_level,
               const level_t start_level = 0,
-              level_t end_level = 0 /* non-inclusive */) {
+              level_t end_level = 0 /* non-inclusive */)
+      : owns_memory_(true) {
     if (end_level == 0) end_level = labels_per_level.size();
 
     num_bytes_ = 1;
     for (level_t level = start_level; level < end_level; level++)
       num_bytes_ += labels_per_level[level].size();
 
-    labels_ = new label_t[num_bytes_];
+    labels_ = new label_t[num_bytes_ + kLabelPadding]();
 
     position_t pos = 0;
     for (level_t level = start_level; level < end_level; level++) {
@@ -33,23 +134,27 @@ class LabelVector {
   }
 
   ~LabelVector() {
-    delete[] labels_;
+    if (owns_memory_) delete[] labels_;
   }
 
   position_t getNumBytes() const { return num_bytes_; }
 
   position_t serializedSize() const {
-    position_t size = sizeof(num_bytes_) + num_bytes_;
+    position_t size = sizeof(num_bytes_) + num_bytes_ + kLabelPadding;
     sizeAlign(size);
     return size;
   }
 
-  position_t size() const { return (sizeof(LabelVector) + num_bytes_); }
+  position_t size() const {
+    return (sizeof(LabelVector) + num_bytes_ + kLabelPadding);
+  }
 
   label_t read(const position_t pos) const { return labels_[pos]; }
 
   label_t operator[](const position_t pos) const { return labels_[pos]; }
 
+  void prefetch(const position_t pos) const { __builtin_prefetch(labels_ + pos); }
+
   bool search(label_t target, position_t &pos, position_t search_len) const;
   bool searchGreaterThan(label_t target, position_t &pos,
                          position_t search_len) const;
@@ -57,6 +162,8 @@ class LabelVector {
   bool binarySearch(label_t target, position_t &pos,
                     position_t search_len) const;
   bool simdSearch(label_t target, position_t &pos, position_t search_len) const;
+  bool simdSearchGreaterThan(label_t target, position_t &pos,
+                             position_t search_len) const;
   bool linearSearch(label_t target, position_t &pos,
                     position_t search_len) const;
 
@@ -68,8 +175,9 @@ class LabelVector {
   void serialize(char *&dst) const {
     memcpy(dst, &num_bytes_, sizeof(num_bytes_));
     dst += sizeof(num_bytes_);
-    memcpy(dst, labels_, num_bytes_);
-    dst += num_bytes_;
+    // the padding is serialized as well to keep deserialized vectors padded
+    memcpy(dst, labels_, num_bytes_ + kLabelPadding);
+    dst += num_bytes_ + kLabelPadding;
     align(dst);
   }
 
@@ -78,8 +186,9 @@ class LabelVector {
     memcpy(&(lv->num_bytes_), src, sizeof(lv->num_bytes_));
     src += sizeof(lv->num_bytes_);
     lv->labels_ = const_cast<label_t *>(reinterpret_cast<const label_t *>(src));
-    src += lv->num_bytes_;
+    src += lv->num_bytes_ + kLabelPadding;
     align(src);
+    lv->owns_memory_ = false;
     return lv;
   }
 
@@ -90,6 +199,7 @@ class LabelVector {
  private:
   position_t num_bytes_;
   label_t *labels_;
+  bool owns_memory_;  // false if labels_ points into a serialized buffer
 };
 
 bool LabelVector::search(const label_t target, position_t &pos,
@@ -117,8 +227,10 @@ bool LabelVector::searchGreaterThan(const label_t target, position_t &pos,
 
   if (search_len < 3)
     return linearSearchGreaterThan(target, pos, search_len);
-  else
+  if (search_len < 12)
     return binarySearchGreaterThan(target, pos, search_len);
+  else
+    return simdSearchGreaterThan(target, pos, search_len);
 }
 
 bool LabelVector::binarySearch(const label_t target, position_t &pos,
@@ -141,37 +253,41 @@ bool LabelVector::binarySearch(const label_t target, position_t &pos,
 
 bool LabelVector::simdSearch(const label_t target, position_t &pos,
                              const position_t search_len) const {
-  // CA: todo fix invalid read
-  position_t num_labels_searched = 0;
-  position_t num_labels_left = search_len;
-  while ((num_labels_left >> 4) > 0) { // while at least 16 elements remain
-    label_t *start_ptr = labels_ + pos + num_labels_searched;
-    __m128i cmp =
-        _mm_cmpeq_epi8(_mm_set1_epi8(target),
-                       _mm_loadu_si128(reinterpret_cast<__m128i *>(start_ptr)));
-    unsigned check_bits = _mm_movemask_epi8(cmp);
-    if (check_bits) {
-      pos += (num_labels_searched + __builtin_ctz(check_bits));
-      return true;
-    }
-    num_labels_searched += 16;
-    num_labels_left -= 16;
-  }
-
-  if (num_labels_left > 0) {
-    label_t *start_ptr = labels_ + pos + num_labels_searched;
-    __m128i cmp =
-        _mm_cmpeq_epi8(_mm_set1_epi8(target),
-                       _mm_loadu_si128(reinterpret_cast<__m128i *>(start_ptr)));
-    unsigned leftover_bits_mask = (1 << num_labels_left) - 1;
-    unsigned check_bits = _mm_movemask_epi8(cmp) & leftover_bits_mask;
-    if (check_bits) {
-      pos += (num_labels_searched + __builtin_ctz(check_bits));
-      return true;
-    }
+  const label_t *start_ptr = labels_ + pos;
+  position_t idx;
+  switch (kLabelSearchSimd) {
+    case LabelSearchSimd::kAvx512:
+      idx = findEqualAvx512(start_ptr, target, search_len);
+      break;
+    case LabelSearchSimd::kAvx2:
+      idx = findEqualAvx2(start_ptr, target, search_len);
+      break;
+    default:
+      idx = findEqualSse2(start_ptr, target, search_len);
   }
+  if (idx == search_len) return false;
+  pos += idx;
+  return true;
+}
 
-  return false;
+bool LabelVector::simdSearchGreaterThan(const label_t target, position_t &pos,
+                                        const position_t search_len) const {
+  if (target == 0xFF) return false;  // no label is greater
+  const label_t *start_ptr = labels_ + pos;
+  position_t idx;
+  switch (kLabelSearchSimd) {
+    case LabelSearchSimd::kAvx512:
+      idx = findGreaterAvx512(start_ptr, target, search_len);
+      break;
+    case LabelSearchSimd::kAvx2:
+      idx = findGreaterAvx2(start_ptr, target, search_len);
+      break;
+    default:
+      idx = findGreaterSse2(start_ptr, target, search_len);
+  }
+  if (idx == search_len) return false;
+  pos += idx;
+  return true;
 }
 
 bool LabelVector::linearSearch(const label_t target, position_t &pos,
@@ -5,7 +5,11 @@
 
 #include "config.hpp"
 #include "fst_builder.hpp"
-#include "rank.hpp"
+#include "iter_path.hpp"
+#include "rank_interleaved.hpp"
+#include "suffix_vector.hpp"
+#include "tombstone_vector.hpp"
+#include "value_vector.hpp"
 
 namespace fst {
 
@@ -36,14 +40,8 @@ class LoudsDense {
           key_len_(0),
           is_at_prefix_key_(false),
           is_skipped_(false),
-          skipped_ht_levels_(0) {
-
-        const auto height = trie_->getHeight();
-        key_.resize(height, 0);
-        pos_in_trie_.resize(height, 0);
-        value_pos_.resize(height, 0);
-        value_pos_initialized_.resize(height, false);
-    }
+          skipped_ht_levels_(0),
+          path_(trie_->getHeight(), 0) {}
 
     void clear();
 
@@ -65,10 +63,13 @@ class LoudsDense {
           (is_move_left_complete_ && is_move_right_complete_));
     }
 
-    int compare(const std::string &key) const;
+    int compare(std::string_view key) const;
 
     std::string getKey() const;
 
+    // getKey without a copy; invalidated by moving the iterator
+    std::string_view keyView() const;
+
     position_t getSendOutNodeNum() const { return send_out_node_num_; };
 
     void setToFirstLabelInNode(size_t node_number, level_t skipped_ht_levels);
@@ -85,8 +86,22 @@ class LoudsDense {
 
     uint64_t getValue() const;
 
+    // key bytes after the unique prefix returned by getKey, if stored
+    std::string_view getSuffix() const;
+
+    // the current key has been erased, see LoudsDense::eraseKey
+    bool isErased() const;
+
     void rankValuePosition(size_t pos);
 
+    // Number of leading levels of the current path that lie on the path of
+    // key, i.e. that a seek to key would walk through again.
+    level_t commonPathLength(std::string_view key) const;
+
+    // Keeps the first len levels of the path and resets everything else,
+    // see resumeMoveToKeyGreaterThan.
+    void truncate(level_t len);
+
     void operator++(int);
 
     void operator--(int);
@@ -117,16 +132,13 @@ class LoudsDense {
     LoudsDense *trie_;
     position_t send_out_node_num_;
     level_t key_len_;  // Does NOT include suffix
-    level_t skipped_ht_levels_;
 
-    std::vector<label_t> key_;
-    std::vector<position_t> pos_in_trie_;
-
-    // stores the index of the current (sparse) value
-    std::vector<position_t> value_pos_;
-    std::vector<bool> value_pos_initialized_;
     bool is_at_prefix_key_;
     bool is_skipped_; // hybrid trie might skip the dense encoding
+    level_t skipped_ht_levels_;
+
+    // key bytes, positions and value positions of the levels
+    IterPath path_;
 
     friend class LoudsDense;
   };
@@ -134,16 +146,19 @@ class LoudsDense {
  public:
   LoudsDense() = default;
 
-  LoudsDense(FSTBuilder *builder,
-             const std::vector<std::string> &keys);
+  explicit LoudsDense(const FSTBuilder *builder);
 
   ~LoudsDense() = default;
 
   // Returns whether key exists in the trie so far
   // out_node_num == 0 means search terminates in louds-dense.
-  bool lookupKey(const std::string &key, position_t &out_node_num,
+  bool lookupKey(std::string_view key, position_t &out_node_num,
                  uint64_t &value) const;
 
+  // Marks key as erased, walking the trie like lookupKey. Returns false if
+  // key does not exist or has been erased before.
+  bool eraseKey(std::string_view key, position_t &out_node_num);
+
   // this function checks if the FST node has only one branch
   bool nodeHasMultipleBranchesOrTerminates(size_t &nodeNumber, size_t level, std::vector<uint8_t> &prefixLabels) const;
 
@@ -159,16 +174,86 @@ class LoudsDense {
 
   bool findNextNodeOrValue(const char keyByte, size_t &node_number) const;
 
+  // The following functions split lookupKey into single-level steps so that
+  // the batched lookup engine (FST::lookupKeys) can interleave several lookups
+  // and prefetch the cache lines of the next step in between.
+  void prefetchStep(position_t node_num, label_t label) const;
+
+  // kChild: node_num is set to the child node
+  // kValue: value_pos is set to the index of the value (see prefetchValue)
+  // kMiss: label does not exist in node node_num
+  StepResult step(label_t label, position_t &node_num,
+                  position_t &value_pos) const;
+
+  void prefetchValue(position_t value_pos) const {
+    values_dense_->prefetch(value_pos);
+    suffixes_dense_->prefetch(value_pos);
+  }
+
+  uint64_t getValue(position_t value_pos) const {
+    return values_dense_->read(value_pos);
+  }
+
+  bool isErased(position_t value_pos) const {
+    return tombstones_->readBit(value_pos);
+  }
+
+  // Compares the key stored at value_pos with key, whose first level + 1
+  // bytes are known to match the stored key.
+  int compareSuffix(position_t value_pos, std::string_view key,
+                    level_t level) const {
+    return suffixes_dense_->compare(value_pos, key.substr(level + 1));
+  }
+
+  // Like moveToKeyGreaterThan, but starts at node nodeNumber of level level
+  // instead of at the root; the iterator's keys omit the levels above. level
+  // is set to the level the search continues at in LoudsSparse.
   void moveToKeyGreaterThanStartingNodeNumber(position_t nodeNumber,
                                               level_t &level,
-                                              const std::string &searched_key,
+                                              std::string_view searched_key,
                                               bool inclusive,
                                               LoudsDense::Iter &iter) const;
 
   // return value indicates potential false positive
-  void moveToKeyGreaterThan(const std::string &searched_key, bool inclusive,
+  void moveToKeyGreaterThan(std::string_view searched_key, bool inclusive,
                             LoudsDense::Iter &iter) const;
 
+  // Like moveToKeyGreaterThan, but starts below the levels iter kept in
+  // Iter::truncate instead of at the root.
+  void resumeMoveToKeyGreaterThan(std::string_view searched_key,
+                                  bool inclusive, LoudsDense::Iter &iter) const;
+
+  // Counts the keys of the dense levels that are less than key. Below the
+  // dense levels the count continues in LoudsSparse::rankKey: node_num is
+  // the node key leads to if on_path, otherwise the first node whose keys
+  // are not less than key; level_node_num is the first node of that level.
+  uint64_t rankKey(std::string_view key, position_t &node_num,
+                   position_t &level_node_num, bool &on_path) const;
+
+  // Counts the keys in the subtries of the positions in [begin, end) of
+  // level level, as far as they are stored on the dense levels. On the first
+  // sparse level, the subtries continue in the nodes [begin_node_num,
+  // end_node_num).
+  uint64_t countKeysInRange(level_t level, position_t begin, position_t end,
+                            position_t &begin_node_num,
+                            position_t &end_node_num) const;
+
+  // Descends the dense levels towards the key with the given ordinal and
+  // appends its labels to prefix. Returns true if the key ends on a dense
+  // level. Otherwise the descent continues in LoudsSparse::selectKey at node
+  // node_num of the first sparse level, and ordinal is the ordinal of the
+  // key within the subtrie of that node.
+  // sparse_keys_in_range(begin_node_num, end_node_num) counts the keys on the
+  // sparse levels in the subtries of the nodes [begin_node_num, end_node_num).
+  template <typename SparseCount>
+  bool selectKey(uint64_t &ordinal, std::string &prefix, position_t &node_num,
+                 SparseCount sparse_keys_in_range) const;
+
+  uint64_t getNumKeys() const { return values_dense_->numValues(); }
+
+  // false if the trie was built without suffixes or has no dense keys
+  bool hasSuffixes() const { return suffixes_dense_->numSuffixes() > 0; }
+
   uint64_t getHeight() const { return height_; };
 
   uint64_t serializedSize() const;
@@ -182,6 +267,9 @@ class LoudsDense {
     label_bitmaps_->serialize(dst);
     child_indicator_bitmaps_->serialize(dst);
     prefixkey_indicator_bits_->serialize(dst);
+    values_dense_->serialize(dst);
+    suffixes_dense_->serialize(dst);
+    tombstones_->serialize(dst);
     align(dst);
   }
 
@@ -190,16 +278,30 @@ class LoudsDense {
     memcpy(&(louds_dense->height_), src, sizeof(louds_dense->height_));
     src += sizeof(louds_dense->height_);
     align(src);
-    louds_dense->label_bitmaps_ = BitvectorRank::deSerialize(src);
-    louds_dense->child_indicator_bitmaps_ = BitvectorRank::deSerialize(src);
-    louds_dense->prefixkey_indicator_bits_ = BitvectorRank::deSerialize(src);
+    louds_dense->label_bitmaps_ = RankVector::deSerialize(src);
+    louds_dense->child_indicator_bitmaps_ = RankVector::deSerialize(src);
+    louds_dense->prefixkey_indicator_bits_ = RankVector::deSerialize(src);
+    louds_dense->values_dense_ = ValueVector::deSerialize(src);
+    louds_dense->suffixes_dense_ = SuffixVector::deSerialize(src);
+    louds_dense->tombstones_ = TombstoneVector::deSerialize(src);
     align(src);
     return louds_dense;
   }
 
  private:
+  // walks searched_key from node node_num on level level
+  void moveToKeyGreaterThan(std::string_view searched_key, bool inclusive,
+                            level_t level, position_t node_num,
+                            LoudsDense::Iter &iter) const;
+
   position_t getChildNodeNum(position_t pos) const;
 
+  // number of leaves, i.e. values, in front of pos
+  position_t getLeafRank(position_t pos) const;
+
+  // the first child node of the positions from pos on
+  position_t getNextChildNodeNum(position_t pos) const;
+
   position_t getSuffixPos(position_t pos, bool is_prefix_key) const;
 
   position_t getNextPos(position_t pos) const;
@@ -210,52 +312,55 @@ class LoudsDense {
   static const position_t kNodeFanout = 256;
   static const position_t kRankBasicBlockSize = 512;
 
-  std::vector<uint64_t> values_dense_;
+  std::unique_ptr<ValueVector> values_dense_;
+  std::unique_ptr<SuffixVector> suffixes_dense_;
+  // erased keys, indexed like the values
+  std::unique_ptr<TombstoneVector> tombstones_;
 
   level_t height_{};
 
-  std::unique_ptr<BitvectorRank> label_bitmaps_;
-  std::unique_ptr<BitvectorRank> child_indicator_bitmaps_;
-  std::unique_ptr<BitvectorRank> prefixkey_indicator_bits_;
-  // const pointer to the original keys
-  const std::vector<std::string> *keys_{};
+  std::unique_ptr<RankVector> label_bitmaps_;
+  std::unique_ptr<RankVector> child_indicator_bitmaps_;
+  std::unique_ptr<RankVector> prefixkey_indicator_bits_;
 };
 
 const position_t LoudsDense::kNodeFanout;
 const position_t LoudsDense::kRankBasicBlockSize;
 
-LoudsDense::LoudsDense(FSTBuilder *builder,
-                       const std::vector<std::string> &keys) {
-  keys_ = &keys;
+LoudsDense::LoudsDense(const FSTBuilder *builder) {
   height_ = builder->getSparseStartLevel();
   std::vector<position_t> num_bits_per_level;
   for (level_t level = 0; level < height_; level++)
     num_bits_per_level.push_back(builder->getBitmapLabels()[level].size() *
         kWordSize);
 
-  label_bitmaps_ = std::make_unique<BitvectorRank>(kRankBasicBlockSize,
+  label_bitmaps_ = std::make_unique<RankVector>(kRankBasicBlockSize,
                                                    builder->getBitmapLabels(),
                                                    num_bits_per_level,
                                                    0,
                                                    height_);
   child_indicator_bitmaps_ =
-      std::make_unique<BitvectorRank>(kRankBasicBlockSize,
+      std::make_unique<RankVector>(kRankBasicBlockSize,
                                       builder->getBitmapChildIndicatorBits(),
                                       num_bits_per_level,
                                       0,
                                       height_);
   prefixkey_indicator_bits_ =
-      std::make_unique<BitvectorRank>(kRankBasicBlockSize,
+      std::make_unique<RankVector>(kRankBasicBlockSize,
                                       builder->getPrefixkeyIndicatorBits(),
                                       builder->getNodeCounts(),
                                       0,
                                       height_);
 
-  // todo make more efficient by completely moving this vector
-  values_dense_ = builder->getDenseValues();
+  values_dense_ = std::make_unique<ValueVector>(builder->getDenseValues(),
+                                                builder->getValueEncoding());
+  suffixes_dense_ =
+      std::make_unique<SuffixVector>(builder->getDenseSuffixOffsets(),
+                                     builder->getDenseSuffixBytes());
+  tombstones_ = std::make_unique<TombstoneVector>(values_dense_->numValues());
 }
 
-bool LoudsDense::lookupKey(const std::string &key, position_t &out_node_num,
+bool LoudsDense::lookupKey(std::string_view key, position_t &out_node_num,
                            uint64_t &value) const {
   position_t node_num = 0;
   position_t pos = 0;
@@ -276,11 +381,28 @@ bool LoudsDense::lookupKey(const std::string &key, position_t &out_node_num,
       uint64_t value_index = label_bitmaps_->rank(pos) -
           child_indicator_bitmaps_->rank(pos) -
           1;  // + prefix but we do not support this so far
-      value = values_dense_[value_index];
+      value = values_dense_->read(value_index);
+      return compareSuffix(value_index, key, level) == 0 &&
+          !tombstones_->readBit(value_index);
+    }
+    node_num = getChildNodeNum(pos);
+  }
+  // search will continue in LoudsSparse
+  out_node_num = node_num;
+  return true;
+}
 
-      // the following check must be performed by the caller
-      // return (*keys_)[value] == key;
-      return true;
+bool LoudsDense::eraseKey(std::string_view key, position_t &out_node_num) {
+  position_t node_num = 0;
+  for (level_t level = 0; level < height_; level++) {
+    if (level >= key.length()) return false;
+    const position_t pos = node_num * kNodeFanout + (label_t) key[level];
+    if (!label_bitmaps_->readBit(pos)) return false;
+
+    if (!child_indicator_bitmaps_->readBit(pos)) {  // if trie branch terminates
+      const position_t value_index = getLeafRank(pos);
+      return compareSuffix(value_index, key, level) == 0 &&
+          tombstones_->setBit(value_index);
     }
     node_num = getChildNodeNum(pos);
   }
@@ -310,12 +432,11 @@ inline bool LoudsDense::lookupKeyAtNode(const char *key,
       uint64_t value_index = label_bitmaps_->rank(pos) -
           child_indicator_bitmaps_->rank(pos) -
           1;  // + prefix but we do not support this so far
-      value = values_dense_[value_index];
-
-      // the following check must be performed by the caller
-      // return (*keys_)[value] == key;
+      value = values_dense_->read(value_index);
       node_num = 0;
-      return true;
+      return compareSuffix(value_index, std::string_view(key, key_length),
+                           level) == 0 &&
+          !tombstones_->readBit(value_index);
     }
     node_num = getChildNodeNum(pos);
   }
@@ -357,7 +478,7 @@ void LoudsDense::getNode(size_t nodeNumber, std::vector<uint8_t> &labels, std::v
       } else {
         // there is a value, push it back and create an ART leaf node
         uint64_t value_index = label_bitmaps_->rank(pos + i) - child_indicator_bitmaps_->rank(pos + i) - 1;
-        auto value = values_dense_[value_index];
+        auto value = values_dense_->read(value_index);
         values.emplace_back((value << 2U) | 1U);
       }
     }
@@ -430,26 +551,73 @@ bool LoudsDense::findNextNodeOrValue(const char keyByte, size_t &node_number) co
     uint64_t value_index =
         label_bitmaps_->rank(pos) -
             child_indicator_bitmaps_->rank(pos) - 1;
-    node_number = (values_dense_[value_index] << 2u) | 1u;
+    node_number = (values_dense_->read(value_index) << 2u) | 1u;
   } else { // branch continues
     node_number = (getChildNodeNum(pos) << 2u) | 3u;
   }
   return true;
 }
 
+void LoudsDense::prefetchStep(const position_t node_num,
+                              const label_t label) const {
+  position_t pos = (node_num * kNodeFanout) + label;
+  label_bitmaps_->prefetch(pos);
+  child_indicator_bitmaps_->prefetch(pos);
+}
+
+StepResult LoudsDense::step(const label_t label, position_t &node_num,
+                            position_t &value_pos) const {
+  position_t pos = (node_num * kNodeFanout) + label;
+  if (!label_bitmaps_->readBit(pos)) return StepResult::kMiss;
+
+  if (!child_indicator_bitmaps_->readBit(pos)) {  // if trie branch terminates
+    value_pos = label_bitmaps_->rank(pos) - child_indicator_bitmaps_->rank(pos) - 1;
+    return StepResult::kValue;
+  }
+  node_num = getChildNodeNum(pos);
+  return StepResult::kChild;
+}
+
 void LoudsDense::moveToKeyGreaterThanStartingNodeNumber(position_t node_num,
                                                         level_t &level,
-                                                        const std::string &searched_key,
+                                                        std::string_view searched_key,
                                                         bool inclusive,
                                                         LoudsDense::Iter &iter) const {
   iter.skipped_ht_levels_ = level;
-  position_t pos;
+  moveToKeyGreaterThan(searched_key, inclusive, level, node_num, iter);
+  // if the search is incomplete, it continues on the first sparse level
+  level = height_;
+}
+
+void LoudsDense::moveToKeyGreaterThan(std::string_view searched_key,
+                                      const bool inclusive,
+                                      LoudsDense::Iter &iter) const {
+  moveToKeyGreaterThan(searched_key, inclusive, 0, 0, iter);
+}
+
+void LoudsDense::resumeMoveToKeyGreaterThan(std::string_view searched_key,
+                                            const bool inclusive,
+                                            LoudsDense::Iter &iter) const {
+  const level_t level = iter.key_len_;
+  const position_t node_num =
+      level == 0 ? 0 : getChildNodeNum(iter.path_.positions()[level - 1]);
+  moveToKeyGreaterThan(searched_key, inclusive, level, node_num, iter);
+}
+
+void LoudsDense::moveToKeyGreaterThan(std::string_view searched_key,
+                                      const bool inclusive, level_t level,
+                                      position_t node_num,
+                                      LoudsDense::Iter &iter) const {
+  position_t pos = 0;
   for (; level < height_; level++) {
     // if is_at_prefix_key_, pos is at the next valid position in the child node
     pos = node_num * kNodeFanout;
     if (level >= searched_key.length()) {  // if run out of searchKey bytes
       // CA: key too short, -> dense (& sparse) traverse to leftmost key a
       iter.append(getNextPos(pos - 1));
+      //if (prefixkey_indicator_bits_->readBit(node_num))  // if the prefix is also a key
+      //  iter.is_at_prefix_key_ = true;
+      //else
       iter.moveToLeftMostKey();
       // valid, search complete, moveLeft complete, moveRight complete
       //iter.setFlags(true, true, true, true);
@@ -459,20 +627,21 @@ void LoudsDense::moveToKeyGreaterThanStartingNodeNumber(position_t node_num,
     pos += (label_t) searched_key[level];
     iter.append(pos);
 
-    // if no exact match
+    // if no exact match, move to the leftmost key of the next greater label
     if (!label_bitmaps_->readBit(pos)) {
-      iter.moveToLeftMostKey(); // search could continue in sparse levels
+      iter++; // search could continue in sparse levels
       return;
     }
 
     // if trie branch terminates
     if (!child_indicator_bitmaps_->readBit(pos)) {
       iter.rankValuePosition(pos);
-      auto found_key = (*keys_)[iter.getValue()];
+      const int cmp = compareSuffix(iter.path_.valuePositions()[iter.key_len_ - 1],
+                                    searched_key, level);
 
-      if (found_key > searched_key) {
+      if (cmp > 0) {
         iter.setFlags(true, true, true, true);
-      } else if (found_key < searched_key) {
+      } else if (cmp < 0) {
         iter++; // no exact match, inclusive flag is not relevant
       } else { // found_key == searched_key
         if (!inclusive)
@@ -493,67 +662,93 @@ void LoudsDense::moveToKeyGreaterThanStartingNodeNumber(position_t node_num,
   iter.setFlags(true, false, true, true);
 }
 
-void LoudsDense::moveToKeyGreaterThan(const std::string &searched_key,
-                                      const bool inclusive,
-                                      LoudsDense::Iter &iter) const {
-  position_t node_num = 0;
-  position_t pos = 0;
+uint64_t LoudsDense::rankKey(std::string_view key, position_t &node_num,
+                             position_t &level_node_num, bool &on_path) const {
+  uint64_t rank = 0;
+  node_num = 0;
+  level_node_num = 0;
+  on_path = true;
   for (level_t level = 0; level < height_; level++) {
-    // if is_at_prefix_key_, pos is at the next valid position in the child node
-    pos = node_num * kNodeFanout;
-    if (level >= searched_key.length()) {  // if run out of searchKey bytes
-      // CA: key too short, -> dense (& sparse) traverse to leftmost key a
-      iter.append(getNextPos(pos - 1));
-      //if (prefixkey_indicator_bits_->readBit(node_num))  // if the prefix is also a key
-      //  iter.is_at_prefix_key_ = true;
-      //else
-      iter.moveToLeftMostKey();
-      // valid, search complete, moveLeft complete, moveRight complete
-      //iter.setFlags(true, true, true, true);
-      return;
+    const position_t level_start = level_node_num * kNodeFanout;
+    // the keys of the positions in front of boundary are less than key
+    position_t boundary = node_num * kNodeFanout;
+    if (on_path && level < key.length()) {
+      boundary += (label_t) key[level];
+      if (!label_bitmaps_->readBit(boundary)) {
+        on_path = false;
+      } else if (!child_indicator_bitmaps_->readBit(boundary)) {
+        if (compareSuffix(getLeafRank(boundary), key, level) < 0) boundary++;
+        on_path = false;
+      }
+    } else {
+      on_path = false;
     }
+    rank += getLeafRank(boundary) - getLeafRank(level_start);
 
-    pos += (label_t) searched_key[level];
-    iter.append(pos);
-
-    // if no exact match
-    if (!label_bitmaps_->readBit(pos)) {
-      iter.moveToLeftMostKey(); // search could continue in sparse levels
-      return;
-    }
+    // the children of the positions in front of boundary
+    level_node_num = getNextChildNodeNum(level_start);
+    node_num = getNextChildNodeNum(boundary);
+  }
+  return rank;
+}
 
-    // if trie branch terminates
-    if (!child_indicator_bitmaps_->readBit(pos)) {
-      iter.rankValuePosition(pos);
-      auto found_key = (*keys_)[iter.getValue()];
+uint64_t LoudsDense::countKeysInRange(level_t level, position_t begin,
+                                      position_t end,
+                                      position_t &begin_node_num,
+                                      position_t &end_node_num) const {
+  uint64_t count = 0;
+  for (; level < height_; level++) {
+    count += getLeafRank(end) - getLeafRank(begin);
+    begin_node_num = getNextChildNodeNum(begin);
+    end_node_num = getNextChildNodeNum(end);
+    begin = begin_node_num * kNodeFanout;
+    end = end_node_num * kNodeFanout;
+  }
+  return count;
+}
 
-      if (found_key > searched_key) {
-        iter.setFlags(true, true, true, true);
-      } else if (found_key < searched_key) {
-        iter++; // no exact match, inclusive flag is not relevant
-      } else { // found_key == searched_key
-        if (!inclusive)
-          iter++;
-        else
-          iter.setFlags(true, true, true, true);
+template <typename SparseCount>
+bool LoudsDense::selectKey(uint64_t &ordinal, std::string &prefix,
+                           position_t &node_num,
+                           SparseCount sparse_keys_in_range) const {
+  node_num = 0;
+  for (level_t level = 0; level < height_; level++) {
+    // the keys in the subtries of the positions [begin, end)
+    auto keys_in_range = [&](const position_t begin, const position_t end) {
+      position_t begin_node_num = 0;
+      position_t end_node_num = 0;
+      const uint64_t count = countKeysInRange(level, begin, end, begin_node_num,
+                                              end_node_num);
+      return count + sparse_keys_in_range(begin_node_num, end_node_num);
+    };
+    // find the position whose subtrie holds the key, ordinal counts the keys
+    // in front of the key from pos on
+    position_t pos = node_num * kNodeFanout;
+    position_t end = pos + kNodeFanout;
+    while (end - pos > 1) {
+      const position_t mid = pos + (end - pos) / 2;
+      const uint64_t count = keys_in_range(pos, mid);
+      if (count <= ordinal) {
+        ordinal -= count;
+        pos = mid;
+      } else {
+        end = mid;
       }
-      // set value index here
-      //iter.rankValuePosition(pos);
-      return;
     }
+    assert(label_bitmaps_->readBit(pos));
+    prefix.push_back((char) (pos % kNodeFanout));
+    if (!child_indicator_bitmaps_->readBit(pos)) return true;
     node_num = getChildNodeNum(pos);
   }
-
-  // search will continue in LoudsSparse
-  iter.setSendOutNodeNum(node_num);
-  // valid, search INCOMPLETE, moveLeft complete, moveRight complete
-  iter.setFlags(true, false, true, true);
+  return false;
 }
 
 uint64_t LoudsDense::serializedSize() const {
   uint64_t size = sizeof(height_) + label_bitmaps_->serializedSize() +
       child_indicator_bitmaps_->serializedSize() +
-      prefixkey_indicator_bits_->serializedSize();
+      prefixkey_indicator_bits_->serializedSize() +
+      values_dense_->serializedSize() + suffixes_dense_->serializedSize() +
+      tombstones_->serializedSize();
   sizeAlign(size);
   return size;
 }
@@ -561,13 +756,22 @@ uint64_t LoudsDense::serializedSize() const {
 uint64_t LoudsDense::getMemoryUsage() const {
   return (sizeof(LoudsDense) + label_bitmaps_->size() +
       child_indicator_bitmaps_->size() + prefixkey_indicator_bits_->size()
-      + values_dense_.size() * 8);
+      + values_dense_->size() + suffixes_dense_->size() + tombstones_->size());
 }
 
 position_t LoudsDense::getChildNodeNum(const position_t pos) const {
   return child_indicator_bitmaps_->rank(pos);
 }
 
+position_t LoudsDense::getLeafRank(const position_t pos) const {
+  if (pos == 0) return 0;
+  return label_bitmaps_->rank(pos - 1) - child_indicator_bitmaps_->rank(pos - 1);
+}
+
+position_t LoudsDense::getNextChildNodeNum(const position_t pos) const {
+  return (pos == 0 ? 0 : getChildNodeNum(pos - 1)) + 1;
+}
+
 position_t LoudsDense::getSuffixPos(const position_t pos,
                                     const bool is_prefix_key) const {
   position_t node_num = pos / kNodeFanout;
@@ -607,41 +811,35 @@ void LoudsDense::Iter::clear() {
   is_at_prefix_key_ = false;
   is_skipped_ = false;
   skipped_ht_levels_ = 0;
-
-  std::fill(key_.begin(), key_.end(), 0);
-  std::fill(pos_in_trie_.begin(), pos_in_trie_.end(), 0);
-  std::fill(value_pos_.begin(), value_pos_.end(), 0);
-  std::fill(value_pos_initialized_.begin(), value_pos_initialized_.end(), false);
-
+  path_.clear();
 }
 
-int LoudsDense::Iter::compare(const std::string &key) const {
+int LoudsDense::Iter::compare(std::string_view key) const {
   if (is_at_prefix_key_ && (key_len_ - 1) < key.length()) return -1;
-  std::string iter_key = getKey();
-  std::string key_dense = key.substr(0, iter_key.length());
-  int compare = iter_key.compare(key_dense);
-  if (compare != 0) return compare;
-  return compare;
+  std::string_view iter_key = keyView();
+  return iter_key.compare(std::string_view(key).substr(0, iter_key.length()));
 }
 
-std::string LoudsDense::Iter::getKey() const {
-  if (!is_valid_) return std::string();
+std::string LoudsDense::Iter::getKey() const { return std::string(keyView()); }
+
+std::string_view LoudsDense::Iter::keyView() const {
+  if (!is_valid_) return std::string_view();
   level_t len = key_len_;
   if (is_at_prefix_key_) len--;
-  return std::string((const char *) key_.data(), (size_t) len);
+  return path_.keyView(len);
 }
 
 void LoudsDense::Iter::append(position_t pos) {
-  assert(key_len_ < key_.size());
-  key_[key_len_] = (label_t) (pos % kNodeFanout);
-  pos_in_trie_[key_len_] = pos;
+  assert(key_len_ < path_.numLevels());
+  path_.keys()[key_len_] = (label_t) (pos % kNodeFanout);
+  path_.positions()[key_len_] = pos;
   key_len_++;
 }
 
 void LoudsDense::Iter::set(level_t level, position_t pos) {
-  assert(level < key_.size());
-  key_[level] = (label_t) (pos % kNodeFanout);
-  pos_in_trie_[level] = pos;
+  assert(level < path_.numLevels());
+  path_.keys()[level] = (label_t) (pos % kNodeFanout);
+  path_.positions()[level] = pos;
 }
 
 void LoudsDense::Iter::setFlags(const bool is_valid,
@@ -659,37 +857,37 @@ void LoudsDense::Iter::setToFirstLabelInNode(size_t node_number, level_t skipped
   skipped_ht_levels_ = skipped_ht_levels;
   position_t pos = node_number * kNodeFanout; // at first position in dense node
   if (trie_->label_bitmaps_->readBit(pos)) {
-    pos_in_trie_[0] = pos;
-    key_[0] = (label_t) (pos % kNodeFanout);
+    path_.positions()[0] = pos;
+    path_.keys()[0] = (label_t) (pos % kNodeFanout);
   } else {
-    pos_in_trie_[0] = trie_->getNextPos(pos);
-    key_[0] = (label_t) (pos_in_trie_[0] % kNodeFanout);
+    path_.positions()[0] = trie_->getNextPos(pos);
+    path_.keys()[0] = (label_t) (path_.positions()[0] % kNodeFanout);
   }
   key_len_++;
 };
 
 void LoudsDense::Iter::setToFirstLabelInRoot() {
   if (trie_->label_bitmaps_->readBit(0)) {
-    pos_in_trie_[0] = 0;
-    key_[0] = (label_t) 0;
+    path_.positions()[0] = 0;
+    path_.keys()[0] = (label_t) 0;
   } else {
-    pos_in_trie_[0] = trie_->getNextPos(0);
-    key_[0] = (label_t) pos_in_trie_[0];
+    path_.positions()[0] = trie_->getNextPos(0);
+    path_.keys()[0] = (label_t) path_.positions()[0];
   }
   key_len_++;
 }
 
 void LoudsDense::Iter::setToLastLabelInRoot() {
   bool is_out_of_bound;
-  pos_in_trie_[0] = trie_->getPrevPos(kNodeFanout, &is_out_of_bound);
-  key_[0] = (label_t) pos_in_trie_[0];
+  path_.positions()[0] = trie_->getPrevPos(kNodeFanout, &is_out_of_bound);
+  path_.keys()[0] = (label_t) path_.positions()[0];
   key_len_++;
 }
 
 void LoudsDense::Iter::moveToLeftMostKey() {
   assert(key_len_ > 0);
   level_t level = key_len_ - 1;
-  position_t pos = pos_in_trie_[level];
+  position_t pos = path_.positions()[level];
   if (!trie_->child_indicator_bitmaps_->readBit(pos)) { // found leaf node, no subtree
     rankValuePosition(pos);
     // valid, search complete, moveLeft complete, moveRight complete
@@ -725,11 +923,15 @@ void LoudsDense::Iter::moveToLeftMostKey() {
 
 void LoudsDense::Iter::moveToRightMostKey() {
   assert(key_len_ > 0);
+  // rankValuePosition only advances the value positions in ascending order
+  path_.clearValuePositions();
   level_t level = key_len_ - 1;
-  position_t pos = pos_in_trie_[level];
-  if (!trie_->child_indicator_bitmaps_->readBit(pos))
+  position_t pos = path_.positions()[level];
+  if (!trie_->child_indicator_bitmaps_->readBit(pos)) {
+    rankValuePosition(pos);
     // valid, search complete, moveLeft complete, moveRight complete
     return setFlags(true, true, true, true);
+  }
 
   while (level < trie_->getHeight() - 1) {
     position_t node_num = trie_->getChildNodeNum(pos);
@@ -742,9 +944,11 @@ void LoudsDense::Iter::moveToRightMostKey() {
     append(pos);
 
     // if trie branch terminates
-    if (!trie_->child_indicator_bitmaps_->readBit(pos))
+    if (!trie_->child_indicator_bitmaps_->readBit(pos)) {
+      rankValuePosition(pos);
       // valid, search complete, moveLeft complete, moveRight complete
       return setFlags(true, true, true, true);
+    }
 
     level++;
   }
@@ -754,32 +958,66 @@ void LoudsDense::Iter::moveToRightMostKey() {
 }
 
 uint64_t LoudsDense::Iter::getLastIteratorPosition() const {
-  return pos_in_trie_[key_len_ - 1];
+  return path_.positions()[key_len_ - 1];
 }
 
 uint64_t LoudsDense::Iter::getValue() const {
-  return trie_->values_dense_[value_pos_[key_len_ - 1]];
+  return trie_->values_dense_->read(path_.valuePositions()[key_len_ - 1]);
+}
+
+std::string_view LoudsDense::Iter::getSuffix() const {
+  return trie_->suffixes_dense_->read(path_.valuePositions()[key_len_ - 1]);
+}
+
+bool LoudsDense::Iter::isErased() const {
+  return trie_->tombstones_->readBit(path_.valuePositions()[key_len_ - 1]);
 }
 
 void LoudsDense::Iter::rankValuePosition(size_t pos) {
-  if (value_pos_initialized_[key_len_ - 1]) {
-    value_pos_[key_len_ - 1]++;
+  if (path_.valuePositionsInitialized()[key_len_ - 1]) {
+    path_.valuePositions()[key_len_ - 1]++;
   } else {  // initially rank value position here
-    value_pos_initialized_[key_len_ - 1] = true;
+    path_.valuePositionsInitialized()[key_len_ - 1] = true;
     uint64_t value_index = trie_->label_bitmaps_->rank(pos) -
         trie_->child_indicator_bitmaps_->rank(pos) -
         1;  // + prefix but we do not support this so far
-    value_pos_[key_len_ - 1] = value_index;
+    path_.valuePositions()[key_len_ - 1] = value_index;
   }
 }
 
+level_t LoudsDense::Iter::commonPathLength(std::string_view key) const {
+  if (!is_valid_ || is_skipped_) return 0;
+  level_t len = 0;
+  // only inner nodes are kept, the walk continues in their child
+  while (len < key_len_ && len < key.length() &&
+      path_.keys()[len] == (label_t) key[len] &&
+      trie_->child_indicator_bitmaps_->readBit(path_.positions()[len]))
+    len++;
+  return len;
+}
+
+void LoudsDense::Iter::truncate(const level_t len) {
+  assert(len <= key_len_);
+  setFlags(false, false, false, false);
+  send_out_node_num_ = 0;
+  key_len_ = len;
+  is_at_prefix_key_ = false;
+  is_skipped_ = false;
+  skipped_ht_levels_ = 0;
+  path_.clearValuePositions();
+}
+
 void LoudsDense::Iter::operator++(int) {
-  assert(key_len_ > 0);
+  // without dense levels, the sparse iterator holds the whole key
+  if (key_len_ == 0) {
+    is_valid_ = false;
+    return;
+  }
   if (is_at_prefix_key_) {
     is_at_prefix_key_ = false;
     return moveToLeftMostKey();
   }
-  position_t pos = pos_in_trie_[key_len_ - 1];
+  position_t pos = path_.positions()[key_len_ - 1];
   position_t next_pos = trie_->getNextPos(pos);
   // if crossing node boundary
   while ((next_pos / kNodeFanout) > (pos / kNodeFanout)) {
@@ -788,7 +1026,7 @@ void LoudsDense::Iter::operator++(int) {
       is_valid_ = false;
       return;
     }
-    pos = pos_in_trie_[key_len_ - 1];
+    pos = path_.positions()[key_len_ - 1];
     next_pos = trie_->getNextPos(pos);
   }
   set(key_len_ - 1, next_pos);
@@ -796,12 +1034,15 @@ void LoudsDense::Iter::operator++(int) {
 }
 
 void LoudsDense::Iter::operator--(int) {
-  assert(key_len_ > 0);
+  if (key_len_ == 0) {
+    is_valid_ = false;
+    return;
+  }
   if (is_at_prefix_key_) {
     is_at_prefix_key_ = false;
     key_len_--;
   }
-  position_t pos = pos_in_trie_[key_len_ - 1];
+  position_t pos = path_.positions()[key_len_ - 1];
   bool is_out_of_bound;
   position_t prev_pos = trie_->getPrevPos(pos, &is_out_of_bound);
   if (is_out_of_bound) {
@@ -824,7 +1065,7 @@ void LoudsDense::Iter::operator--(int) {
       is_valid_ = false;
       return;
     }
-    pos = pos_in_trie_[key_len_ - 1];
+    pos = path_.positions()[key_len_ - 1];
     prev_pos = trie_->getPrevPos(pos, &is_out_of_bound);
     if (is_out_of_bound) {
       is_valid_ = false;
@@ -5,9 +5,13 @@
 
 #include "config.hpp"
 #include "fst_builder.hpp"
+#include "iter_path.hpp"
 #include "label_vector.hpp"
-#include "rank.hpp"
+#include "rank_interleaved.hpp"
 #include "select.hpp"
+#include "suffix_vector.hpp"
+#include "tombstone_vector.hpp"
+#include "value_vector.hpp"
 
 namespace fst {
 
@@ -30,21 +34,27 @@ class LoudsSparse {
           key_len_(0),
           is_at_terminator_(false) {
       start_level_ = trie_->getStartLevel();
-      const auto height = trie_->getHeight() - start_level_;
-      key_.resize(height, 0);
-      pos_in_trie_.resize(height, 0);
-      value_pos_.resize(height, 0);
-      value_pos_initialized_.resize(height, false);
+      // the key bytes of the dense levels go in front, see setPrefix
+      path_ = IterPath(trie_->getHeight() - start_level_, start_level_);
     }
 
     void clear();
 
     bool isValid() const { return is_valid_; };
 
-    int compare(const std::string &key) const;
+    int compare(std::string_view key) const;
 
     std::string getKey() const;
 
+    // getKey without a copy; invalidated by moving the iterator
+    std::string_view keyView() const;
+
+    // the prefix passed to setPrefix followed by keyView()
+    std::string_view prefixedKeyView() const;
+
+    // key bytes of the levels above start_level_, e.g. of the dense iterator
+    void setPrefix(std::string_view prefix) { path_.setPrefix(prefix); }
+
     position_t getStartNodeNum() const { return start_node_num_; };
 
     void setStartNodeNum(position_t node_num) { start_node_num_ = node_num; };
@@ -59,15 +69,31 @@ class LoudsSparse {
 
     uint64_t getValue() const;
 
+    // key bytes after the unique prefix returned by getKey, if stored
+    std::string_view getSuffix() const;
+
+    // the current key has been erased, see LoudsSparse::eraseKey
+    bool isErased() const;
+
     uint64_t getLastIteratorPosition() const;
 
     void rankValuePosition(size_t pos);
 
+    // Number of leading levels of the current path that lie on the path of
+    // key, i.e. that a seek to key would walk through again.
+    level_t commonPathLength(std::string_view key) const;
+
+    // Keeps the first len levels of the path and resets everything else,
+    // see resumeMoveToKeyGreaterThan.
+    void truncate(level_t len);
+
     void operator++(int);
 
     void operator--(int);
 
    private:
+    level_t keyLength() const;
+
     void append(position_t pos);
 
     void append(label_t label, position_t pos);
@@ -82,34 +108,84 @@ class LoudsSparse {
     level_t
         key_len_;  // Start counting from start_level_; does NOT include suffix
 
-    std::vector<label_t> key_;
-    std::vector<position_t> pos_in_trie_;
-
-    // stores the index of the current (sparse) value
-    std::vector<position_t> value_pos_;
-    std::vector<bool> value_pos_initialized_;
     bool is_at_terminator_;
 
+    // key bytes, positions and value positions of the levels
+    IterPath path_;
+
     friend class LoudsSparse;
   };
 
  public:
   LoudsSparse() {};
 
-  LoudsSparse(const FSTBuilder *builder, const std::vector<std::string> &keys);
+  explicit LoudsSparse(const FSTBuilder *builder);
 
   ~LoudsSparse() {}
 
   // point query: trie walk starts at node "in_node_num" instead of root
   // in_node_num is provided by louds-dense's lookupKey function
-  bool lookupKey(const std::string &key, position_t in_node_num,
+  bool lookupKey(std::string_view key, position_t in_node_num,
                  uint64_t &value) const;
 
+  // Marks key as erased, walking the trie like lookupKey. Returns false if
+  // key does not exist or has been erased before.
+  bool eraseKey(std::string_view key, position_t in_node_num);
+
   bool lookupKeyAtNode(const char *key, uint64_t key_length, position_t in_node_num,
                        uint64_t &value, uint64_t level) const;
 
   bool findNextNodeOrValue(const char keyByte, size_t &node_number) const;
 
+  // The following functions split lookupKey into single-level steps so that
+  // the batched lookup engine (FST::lookupKeys) can interleave several lookups.
+  // A step on node node_num takes three stages, each of which prefetches
+  // the memory needed by the next one:
+  // prefetchSelectSample -> prefetchSelectWord -> prefetchNode -> step
+  void prefetchSelectSample(position_t node_num) const {
+    louds_bits_->prefetchSample(node_num + 1 - node_count_dense_);
+  }
+
+  void prefetchSelectWord(position_t node_num) const {
+    louds_bits_->prefetchWord(node_num + 1 - node_count_dense_);
+  }
+
+  // returns the position of the first label in node node_num
+  position_t prefetchNode(position_t node_num) const;
+
+  // pos is the value returned by prefetchNode(node_num)
+  // kChild: node_num is set to the child node
+  // kValue: value_pos is set to the index of the value (see prefetchValue)
+  // kMiss: label does not exist in node node_num
+  StepResult step(label_t label, position_t pos, position_t &node_num,
+                  position_t &value_pos) const;
+
+  // step without prefetching, like LoudsDense::step
+  StepResult step(label_t label, position_t &node_num,
+                  position_t &value_pos) const {
+    return step(label, getFirstLabelPos(node_num), node_num, value_pos);
+  }
+
+  void prefetchValue(position_t value_pos) const {
+    values_sparse_->prefetch(value_pos);
+    suffixes_sparse_->prefetch(value_pos);
+  }
+
+  uint64_t getValue(position_t value_pos) const {
+    return values_sparse_->read(value_pos);
+  }
+
+  bool isErased(position_t value_pos) const {
+    return tombstones_->readBit(value_pos);
+  }
+
+  // Compares the key stored at value_pos with key, whose first level + 1
+  // bytes are known to match the stored key.
+  int compareSuffix(position_t value_pos, std::string_view key,
+                    level_t level) const {
+    return suffixes_sparse_->compare(value_pos, key.substr(level + 1));
+  }
+
   bool nodeHasMultipleBranchesOrTerminates(size_t &nodeNumber, size_t level, std::vector<uint8_t> &prefixLabels) const;
 
   void getNode(size_t nodeNumber, std::vector<uint8_t> &labels, std::vector<uint64_t> &values);
@@ -118,12 +194,43 @@ class LoudsSparse {
 
   bool lookupNodeNumberOption(const char *key, uint64_t key_length, position_t &out_node_num) const;
 
-  void moveToKeyGreaterThan(const std::string &searched_key, bool inclusive, level_t level,
+  void moveToKeyGreaterThan(std::string_view searched_key, bool inclusive, level_t level,
                             LoudsSparse::Iter &iter) const;
 
-  void moveToKeyGreaterThan(const std::string &searched_key, bool inclusive,
+  void moveToKeyGreaterThan(std::string_view searched_key, bool inclusive,
                             LoudsSparse::Iter &iter) const;
 
+  // Like moveToKeyGreaterThan, but starts below the levels iter kept in
+  // Iter::truncate instead of at its start node.
+  void resumeMoveToKeyGreaterThan(std::string_view searched_key,
+                                  bool inclusive,
+                                  LoudsSparse::Iter &iter) const;
+
+  // Counts the keys of the sparse levels that are less than key, starting
+  // where LoudsDense::rankKey stopped (node 0 of level 0 without dense
+  // levels).
+  uint64_t rankKey(std::string_view key, position_t node_num,
+                   position_t level_node_num, bool on_path) const;
+
+  // Counts the keys in the subtries of the positions in [begin, end) of
+  // level level.
+  uint64_t countKeysInRange(level_t level, position_t begin,
+                            position_t end) const;
+
+  // Descends from node node_num of the first sparse level to the key with the
+  // given ordinal within the subtrie of the node and appends its labels to
+  // prefix, see LoudsDense::selectKey.
+  void selectKey(uint64_t ordinal, position_t node_num,
+                 std::string &prefix) const;
+
+  // first position of node node_num, or the end if there is no such node
+  position_t getNodeStart(position_t node_num) const;
+
+  uint64_t getNumKeys() const { return values_sparse_->numValues(); }
+
+  // false if the trie was built without suffixes or has no sparse keys
+  bool hasSuffixes() const { return suffixes_sparse_->numSuffixes() > 0; }
+
   level_t getHeight() const { return height_; };
 
   level_t getStartLevel() const { return start_level_; };
@@ -145,6 +252,9 @@ class LoudsSparse {
     labels_->serialize(dst);
     child_indicator_bits_->serialize(dst);
     louds_bits_->serialize(dst);
+    values_sparse_->serialize(dst);
+    suffixes_sparse_->serialize(dst);
+    tombstones_->serialize(dst);
     align(dst);
   }
 
@@ -163,19 +273,33 @@ class LoudsSparse {
     src += sizeof(louds_sparse->child_count_dense_);
     align(src);
     louds_sparse->labels_ = LabelVector::deSerialize(src);
-    louds_sparse->child_indicator_bits_ = BitvectorRank::deSerialize(src);
+    louds_sparse->child_indicator_bits_ = RankVector::deSerialize(src);
     louds_sparse->louds_bits_ = BitvectorSelect::deSerialize(src);
+    louds_sparse->values_sparse_ = ValueVector::deSerialize(src);
+    louds_sparse->suffixes_sparse_ = SuffixVector::deSerialize(src);
+    louds_sparse->tombstones_ = TombstoneVector::deSerialize(src);
     align(src);
     return louds_sparse;
   }
 
  private:
+  // walks searched_key from node node_num on level level
+  void moveToKeyGreaterThan(std::string_view searched_key, bool inclusive,
+                            level_t level, position_t node_num,
+                            LoudsSparse::Iter &iter) const;
+
   position_t getChildNodeNum(position_t pos) const;
 
   position_t getFirstLabelPos(position_t node_num) const;
 
   position_t getLastLabelPos(position_t node_num) const;
 
+  // number of leaves, i.e. values, in front of pos
+  position_t getLeafRank(position_t pos) const;
+
+  // the first child node of the positions from pos on
+  position_t getNextChildNodeNum(position_t pos) const;
+
   position_t getSuffixPos(position_t pos) const;
 
   position_t nodeSize(position_t pos) const;
@@ -187,7 +311,7 @@ class LoudsSparse {
                                LoudsSparse::Iter &iter) const;
 
   // return value indicates potential false positive
-  bool compareSuffixGreaterThan(position_t pos, const std::string &key,
+  bool compareSuffixGreaterThan(position_t pos, std::string_view key,
                                 level_t level, bool inclusive,
                                 LoudsSparse::Iter &iter) const;
 
@@ -195,7 +319,10 @@ class LoudsSparse {
   static const position_t kRankBasicBlockSize = 512;
   static const position_t kSelectSampleInterval = 64;
 
-  std::vector<uint64_t> values_sparse_;
+  std::unique_ptr<ValueVector> values_sparse_;
+  std::unique_ptr<SuffixVector> suffixes_sparse_;
+  // erased keys, indexed like the values
+  std::unique_ptr<TombstoneVector> tombstones_;
 
   level_t height_;       // trie height
   level_t start_level_;  // louds-sparse encoding starts at this level
@@ -205,18 +332,14 @@ class LoudsSparse {
   position_t child_count_dense_;
 
   std::unique_ptr<LabelVector> labels_;
-  std::unique_ptr<BitvectorRank> child_indicator_bits_;
+  std::unique_ptr<RankVector> child_indicator_bits_;
   std::unique_ptr<BitvectorSelect> louds_bits_;
-  // pointer to the original data
-  const std::vector<std::string> *keys_;
 };
 
 const position_t LoudsSparse::kRankBasicBlockSize;
 const position_t LoudsSparse::kSelectSampleInterval;
 
-LoudsSparse::LoudsSparse(const FSTBuilder *builder,
-                         const std::vector<std::string> &keys) {
-  keys_ = &keys;
+LoudsSparse::LoudsSparse(const FSTBuilder *builder) {
   height_ = builder->getLabels().size();
   start_level_ = builder->getSparseStartLevel();
 
@@ -238,7 +361,7 @@ LoudsSparse::LoudsSparse(const FSTBuilder *builder,
   for (level_t level = 0; level < height_; level++) {
     num_items_per_level.push_back(builder->getLabels()[level].size());
   }
-  child_indicator_bits_ = std::make_unique<BitvectorRank>(kRankBasicBlockSize,
+  child_indicator_bits_ = std::make_unique<RankVector>(kRankBasicBlockSize,
                                                           builder->getChildIndicatorBits(),
                                                           num_items_per_level,
                                                           start_level_,
@@ -249,10 +372,15 @@ LoudsSparse::LoudsSparse(const FSTBuilder *builder,
                                                   start_level_,
                                                   height_);
 
-  values_sparse_ = builder->getSparseValues();
+  values_sparse_ = std::make_unique<ValueVector>(builder->getSparseValues(),
+                                                 builder->getValueEncoding());
+  suffixes_sparse_ =
+      std::make_unique<SuffixVector>(builder->getSparseSuffixOffsets(),
+                                     builder->getSparseSuffixBytes());
+  tombstones_ = std::make_unique<TombstoneVector>(values_sparse_->numValues());
 }
 
-bool LoudsSparse::lookupKey(const std::string &key,
+bool LoudsSparse::lookupKey(std::string_view key,
                             const position_t in_node_num,
                             uint64_t &value) const {
   position_t node_num = in_node_num;
@@ -268,10 +396,9 @@ bool LoudsSparse::lookupKey(const std::string &key,
     // if trie branch terminates
     if (!child_indicator_bits_->readBit(pos)) {
       uint64_t value_pos = pos - child_indicator_bits_->rank(pos);
-      value = values_sparse_[value_pos];
-      //this check must be performed from the caller
-      // return (*keys_)[value] == key;
-      return true;
+      value = values_sparse_->read(value_pos);
+      return compareSuffix(value_pos, key, level) == 0 &&
+          !tombstones_->readBit(value_pos);
     }
 
     // move to child
@@ -281,6 +408,24 @@ bool LoudsSparse::lookupKey(const std::string &key,
   return false;
 }
 
+bool LoudsSparse::eraseKey(std::string_view key,
+                           const position_t in_node_num) {
+  position_t pos = getFirstLabelPos(in_node_num);
+  for (level_t level = start_level_; level < key.length(); level++) {
+    if (!labels_->search((label_t) key[level], pos, nodeSize(pos)))
+      return false;
+
+    // if trie branch terminates
+    if (!child_indicator_bits_->readBit(pos)) {
+      const position_t value_pos = pos - child_indicator_bits_->rank(pos);
+      return compareSuffix(value_pos, key, level) == 0 &&
+          tombstones_->setBit(value_pos);
+    }
+    pos = getFirstLabelPos(getChildNodeNum(pos));
+  }
+  return false;
+}
+
 inline bool LoudsSparse::lookupKeyAtNode(const char *key, uint64_t key_length, position_t in_node_num,
                                          uint64_t &value, uint64_t level) const {
   position_t node_num = in_node_num;
@@ -295,10 +440,10 @@ inline bool LoudsSparse::lookupKeyAtNode(const char *key, uint64_t key_length, p
     // if trie branch terminates
     if (!child_indicator_bits_->readBit(pos)) {
       uint64_t value_pos = pos - child_indicator_bits_->rank(pos);
-      value = values_sparse_[value_pos];
-      //this check must be performed from the caller
-      // return (*keys_)[value] == key;
-      return true;
+      value = values_sparse_->read(value_pos);
+      return compareSuffix(value_pos, std::string_view(key, key_length),
+                           level) == 0 &&
+          !tombstones_->readBit(value_pos);
     }
 
     // move to child
@@ -324,7 +469,7 @@ bool LoudsSparse::findNextNodeOrValue(const char keyByte, size_t &node_num) cons
   // find next node or value
   if (!child_indicator_bits_->readBit(pos)) { // branch terminates
     uint64_t value_pos = pos - child_indicator_bits_->rank(pos);
-    uint64_t value = values_sparse_[value_pos];
+    uint64_t value = values_sparse_->read(value_pos);
     node_num = (value << 2u) | 1u;
   } else { // branch continues
     node_num = (getChildNodeNum(pos) << 2u) | 3u;
@@ -332,6 +477,28 @@ bool LoudsSparse::findNextNodeOrValue(const char keyByte, size_t &node_num) cons
   return true;
 }
 
+position_t LoudsSparse::prefetchNode(const position_t node_num) const {
+  position_t pos = getFirstLabelPos(node_num);
+  labels_->prefetch(pos);
+  child_indicator_bits_->prefetch(pos);
+  louds_bits_->prefetch(pos);
+  return pos;
+}
+
+StepResult LoudsSparse::step(const label_t label, position_t pos,
+                             position_t &node_num,
+                             position_t &value_pos) const {
+  if (!labels_->search(label, pos, nodeSize(pos))) return StepResult::kMiss;
+
+  // if trie branch terminates
+  if (!child_indicator_bits_->readBit(pos)) {
+    value_pos = pos - child_indicator_bits_->rank(pos);
+    return StepResult::kValue;
+  }
+  node_num = getChildNodeNum(pos);
+  return StepResult::kChild;
+}
+
 void LoudsSparse::getNode(size_t nodeNumber, std::vector<uint8_t> &labels, std::vector<uint64_t> &values) {
   position_t pos = getFirstLabelPos(nodeNumber);
   size_t size = nodeSize(pos);
@@ -342,7 +509,7 @@ void LoudsSparse::getNode(size_t nodeNumber, std::vector<uint8_t> &labels, std::
       values.emplace_back(childNodeNum << 2U | 3U);
     } else { // leads to a value
       uint64_t value_pos = i - child_indicator_bits_->rank(i);
-      auto value = values_sparse_[value_pos];
+      auto value = values_sparse_->read(value_pos);
       values.emplace_back(value << 2U | 1U);
     }
   }
@@ -370,6 +537,7 @@ void LoudsSparse::lookupNodeNumber(const char *key, uint64_t key_length, positio
   for (uint64_t level = start_level_; level < key_length; level++) {
     bool found_label = labels_->search((label_t) key[level], pos, nodeSize(pos));
     assert(found_label);
+    (void) found_label;
     assert(child_indicator_bits_->readBit(pos));
     // move to child
     node_num = getChildNodeNum(pos);
@@ -390,11 +558,36 @@ bool LoudsSparse::lookupNodeNumberOption(const char *key, uint64_t key_length, p
   return true;
 }
 
-void LoudsSparse::moveToKeyGreaterThan(const std::string &searched_key,
+void LoudsSparse::moveToKeyGreaterThan(std::string_view searched_key,
                                        const bool inclusive,
                                        level_t level,
                                        LoudsSparse::Iter &iter) const {
-  position_t node_num = iter.getStartNodeNum();
+  moveToKeyGreaterThan(searched_key, inclusive, level, iter.getStartNodeNum(),
+                       iter);
+}
+
+void LoudsSparse::moveToKeyGreaterThan(std::string_view searched_key,
+                                       const bool inclusive,
+                                       LoudsSparse::Iter &iter) const {
+  moveToKeyGreaterThan(searched_key, inclusive, start_level_,
+                       iter.getStartNodeNum(), iter);
+}
+
+void LoudsSparse::resumeMoveToKeyGreaterThan(std::string_view searched_key,
+                                             const bool inclusive,
+                                             LoudsSparse::Iter &iter) const {
+  const level_t len = iter.key_len_;
+  const position_t node_num =
+      len == 0 ? iter.getStartNodeNum()
+               : getChildNodeNum(iter.path_.positions()[len - 1]);
+  moveToKeyGreaterThan(searched_key, inclusive, start_level_ + len, node_num,
+                       iter);
+}
+
+void LoudsSparse::moveToKeyGreaterThan(std::string_view searched_key,
+                                       const bool inclusive, level_t level,
+                                       position_t node_num,
+                                       LoudsSparse::Iter &iter) const {
   position_t pos = getFirstLabelPos(node_num);
 
   for (; level < searched_key.length(); level++) {
@@ -409,11 +602,12 @@ void LoudsSparse::moveToKeyGreaterThan(const std::string &searched_key,
 
     if (!child_indicator_bits_->readBit(pos)) { // trie branch terminates
       iter.rankValuePosition(pos);
-      auto found_key = (*keys_)[iter.getValue()];
+      const int cmp = compareSuffix(iter.path_.valuePositions()[iter.key_len_ - 1],
+                                    searched_key, level);
 
-      if (found_key > searched_key) {
+      if (cmp > 0) {
         iter.is_valid_ = true;
-      } else if (found_key < searched_key) {
+      } else if (cmp < 0) {
         iter++;
       } else { // found_key == searched_key
         if (!inclusive)
@@ -446,60 +640,76 @@ void LoudsSparse::moveToKeyGreaterThan(const std::string &searched_key,
   iter.is_valid_ = true;
 }
 
-void LoudsSparse::moveToKeyGreaterThan(const std::string &searched_key,
-                                       const bool inclusive,
-                                       LoudsSparse::Iter &iter) const {
-  position_t node_num = iter.getStartNodeNum();
-  position_t pos = getFirstLabelPos(node_num);
-
-  level_t level;
-  for (level = start_level_; level < searched_key.length(); level++) {
-    position_t node_size = nodeSize(pos);
-    // if no exact match
-    if (!labels_->search((label_t) searched_key[level], pos, node_size)) {
-      // do not return false, but just move to the next bigger key?
-      moveToLeftInNextSubtrie(pos, node_size, searched_key[level], iter);
-      return;
-    }
-    iter.append(searched_key[level], pos);
-
-    if (!child_indicator_bits_->readBit(pos)) { // / trie branch terminates
-      iter.rankValuePosition(pos);
-      auto found_key = (*keys_)[iter.getValue()];
-
-      if (found_key > searched_key) {
-        iter.is_valid_ = true;
-      } else if (found_key < searched_key) {
-        iter++;
-      } else { // found_key == searched_key
-        if (!inclusive)
-          iter++;
+uint64_t LoudsSparse::rankKey(std::string_view key, position_t node_num,
+                              position_t level_node_num, bool on_path) const {
+  uint64_t rank = 0;
+  for (level_t level = start_level_; level < height_; level++) {
+    const position_t level_start = getNodeStart(level_node_num);
+    // the keys of the positions in front of boundary are less than key
+    position_t boundary = getNodeStart(node_num);
+    if (on_path && level < key.length()) {
+      const label_t label = (label_t) key[level];
+      const position_t node_size = nodeSize(boundary);
+      position_t pos = boundary;
+      if (labels_->search(label, pos, node_size)) {
+        boundary = pos;
+        if (!child_indicator_bits_->readBit(boundary)) {
+          if (compareSuffix(getSuffixPos(boundary), key, level) < 0) boundary++;
+          on_path = false;
+        }
+      } else {
+        pos = boundary;
+        if (labels_->searchGreaterThan(label, pos, node_size))
+          boundary = pos;
         else
-          iter.is_valid_ = true;
+          boundary += node_size;
+        on_path = false;
       }
-      return;
+    } else {
+      on_path = false;
     }
-    // move to child
-    node_num = getChildNodeNum(pos);
-    pos = getFirstLabelPos(node_num);
-  }
+    rank += getLeafRank(boundary) - getLeafRank(level_start);
+    if (!on_path && boundary == level_start) break;
 
-  if ((labels_->read(pos) == kTerminator) &&
-      (!child_indicator_bits_->readBit(pos)) && !isEndofNode(pos)) {
-    iter.append(kTerminator, pos);
-    iter.is_at_terminator_ = true;
-    if (!inclusive) iter++;
-    iter.is_valid_ = true;
-    return;
+    // the children of the positions in front of boundary
+    level_node_num = getNextChildNodeNum(level_start);
+    node_num = getNextChildNodeNum(boundary);
   }
+  return rank;
+}
 
-  // searched key is smaller -> move to leftmost key
-  if (searched_key.length() <= level) {
-    iter.moveToLeftMostKey();
-    return;
+uint64_t LoudsSparse::countKeysInRange(level_t level, position_t begin,
+                                       position_t end) const {
+  uint64_t count = 0;
+  for (; level < height_ && begin < end; level++) {
+    count += getLeafRank(end) - getLeafRank(begin);
+    begin = getNodeStart(getNextChildNodeNum(begin));
+    end = getNodeStart(getNextChildNodeNum(end));
   }
+  return count;
+}
 
-  iter.is_valid_ = true;
+void LoudsSparse::selectKey(uint64_t ordinal, position_t node_num,
+                            std::string &prefix) const {
+  for (level_t level = start_level_; level < height_; level++) {
+    // find the position whose subtrie holds the key, ordinal counts the keys
+    // in front of the key from pos on
+    position_t pos = getNodeStart(node_num);
+    position_t end = pos + nodeSize(pos);
+    while (end - pos > 1) {
+      const position_t mid = pos + (end - pos) / 2;
+      const uint64_t count = countKeysInRange(level, pos, mid);
+      if (count <= ordinal) {
+        ordinal -= count;
+        pos = mid;
+      } else {
+        end = mid;
+      }
+    }
+    prefix.push_back((char) labels_->read(pos));
+    if (!child_indicator_bits_->readBit(pos)) return;
+    node_num = getChildNodeNum(pos);
+  }
 }
 
 uint64_t LoudsSparse::serializedSize() const {
@@ -507,14 +717,16 @@ uint64_t LoudsSparse::serializedSize() const {
       sizeof(height_) + sizeof(start_level_) + sizeof(node_count_dense_) +
           sizeof(child_count_dense_) + labels_->serializedSize() +
           child_indicator_bits_->serializedSize()
-          + louds_bits_->serializedSize();
+          + louds_bits_->serializedSize() + values_sparse_->serializedSize()
+          + suffixes_sparse_->serializedSize() + tombstones_->serializedSize();
   sizeAlign(size);
   return size;
 }
 
 uint64_t LoudsSparse::getMemoryUsage() const {
   return (sizeof(*this) + labels_->size() + child_indicator_bits_->size() +
-      louds_bits_->size() + values_sparse_.size() * 8);
+      louds_bits_->size() + values_sparse_->size() + suffixes_sparse_->size() +
+      tombstones_->size());
 }
 
 position_t LoudsSparse::getChildNodeNum(const position_t pos) const {
@@ -531,6 +743,22 @@ position_t LoudsSparse::getLastLabelPos(const position_t node_num) const {
   return (louds_bits_->select(next_rank) - 1);
 }
 
+position_t LoudsSparse::getNodeStart(const position_t node_num) const {
+  const position_t rank = node_num + 1 - node_count_dense_;
+  if (rank > louds_bits_->numOnes()) return louds_bits_->numBits();
+  return louds_bits_->select(rank);
+}
+
+position_t LoudsSparse::getLeafRank(const position_t pos) const {
+  if (pos == 0) return 0;
+  return pos - child_indicator_bits_->rank(pos - 1);
+}
+
+position_t LoudsSparse::getNextChildNodeNum(const position_t pos) const {
+  return (pos == 0 ? 0 : child_indicator_bits_->rank(pos - 1)) +
+      child_count_dense_ + 1;
+}
+
 position_t LoudsSparse::getSuffixPos(const position_t pos) const {
   return (pos - child_indicator_bits_->rank(pos));
 }
@@ -559,7 +787,7 @@ void LoudsSparse::moveToLeftInNextSubtrie(position_t pos,
 }
 
 bool LoudsSparse::compareSuffixGreaterThan(const position_t pos,
-                                           const std::string &key,
+                                           std::string_view key,
                                            const level_t level,
                                            const bool inclusive,
                                            LoudsSparse::Iter &iter) const {
@@ -582,61 +810,63 @@ void LoudsSparse::Iter::clear() {
   key_len_ = 0;
   is_at_terminator_ = false;
   start_level_ = trie_->getStartLevel();
-
-  std::fill(key_.begin(), key_.end(), 0);
-  std::fill(pos_in_trie_.begin(), pos_in_trie_.end(), 0);
-  std::fill(value_pos_.begin(), value_pos_.end(), 0);
-  std::fill(value_pos_initialized_.begin(), value_pos_initialized_.end(), false);
+  path_.clear();
 }
 
-int LoudsSparse::Iter::compare(const std::string &key) const {
+int LoudsSparse::Iter::compare(std::string_view key) const {
   if (is_at_terminator_ && (key_len_ - 1) < (key.length() - start_level_))
     return -1;
-  std::string iter_key = getKey();
-  std::string key_sparse = key.substr(start_level_);
-  std::string key_sparse_same_length = key_sparse.substr(0, iter_key.length());
-  int compare = iter_key.compare(key_sparse_same_length);
-  if (compare != 0) return compare;
-  return compare;
+  std::string_view iter_key = keyView();
+  std::string_view key_sparse = std::string_view(key).substr(start_level_);
+  return iter_key.compare(key_sparse.substr(0, iter_key.length()));
 }
 
-std::string LoudsSparse::Iter::getKey() const {
-  if (!is_valid_) return std::string();
-  level_t len = key_len_;
-  if (is_at_terminator_) len--;
-  return std::string((const char *) key_.data(), (size_t) len);
+std::string LoudsSparse::Iter::getKey() const { return std::string(keyView()); }
+
+level_t LoudsSparse::Iter::keyLength() const {
+  return is_at_terminator_ ? key_len_ - 1 : key_len_;
+}
+
+std::string_view LoudsSparse::Iter::keyView() const {
+  if (!is_valid_) return std::string_view();
+  return path_.keyView(keyLength());
+}
+
+std::string_view LoudsSparse::Iter::prefixedKeyView() const {
+  if (!is_valid_) return std::string_view();
+  return path_.prefixedKeyView(keyLength());
 }
 
 void LoudsSparse::Iter::append(const position_t pos) {
-  assert(key_len_ < key_.size());
-  key_[key_len_] = trie_->labels_->read(pos);
-  pos_in_trie_[key_len_] = pos;
+  assert(key_len_ < path_.numLevels());
+  path_.keys()[key_len_] = trie_->labels_->read(pos);
+  path_.positions()[key_len_] = pos;
   key_len_++;
 }
 
 void LoudsSparse::Iter::append(const label_t label, const position_t pos) {
-  assert(key_len_ < key_.size());
-  key_[key_len_] = label;
-  pos_in_trie_[key_len_] = pos;
+  assert(key_len_ < path_.numLevels());
+  path_.keys()[key_len_] = label;
+  path_.positions()[key_len_] = pos;
   key_len_++;
 }
 
 void LoudsSparse::Iter::set(const level_t level, const position_t pos) {
-  assert(level < key_.size());
-  key_[level] = trie_->labels_->read(pos);
-  pos_in_trie_[level] = pos;
+  assert(level < path_.numLevels());
+  path_.keys()[level] = trie_->labels_->read(pos);
+  path_.positions()[level] = pos;
 }
 
 void LoudsSparse::Iter::setToFirstLabelInRoot() {
   assert(start_level_ == 0);
-  pos_in_trie_[0] = 0;
-  key_[0] = trie_->labels_->read(0);
+  path_.positions()[0] = 0;
+  path_.keys()[0] = trie_->labels_->read(0);
 }
 
 void LoudsSparse::Iter::setToLastLabelInRoot() {
   assert(start_level_ == 0);
-  pos_in_trie_[0] = trie_->getLastLabelPos(0);
-  key_[0] = trie_->labels_->read(pos_in_trie_[0]);
+  path_.positions()[0] = trie_->getLastLabelPos(0);
+  path_.keys()[0] = trie_->labels_->read(path_.positions()[0]);
 }
 
 // fixme
@@ -648,7 +878,7 @@ void LoudsSparse::Iter::moveToLeftMostKey() {
   }
 
   level_t level = key_len_ - 1;
-  position_t pos = pos_in_trie_[level];
+  position_t pos = path_.positions()[level];
   label_t label = trie_->labels_->read(pos);
 
   if (!trie_->child_indicator_bits_->readBit(pos)) {
@@ -679,6 +909,8 @@ void LoudsSparse::Iter::moveToLeftMostKey() {
 }
 
 void LoudsSparse::Iter::moveToRightMostKey() {
+  // rankValuePosition only advances the value positions in ascending order
+  path_.clearValuePositions();
   if (key_len_ == 0) {
     // todo can we remove the following statement since it has no effect?
     trie_->getFirstLabelPos(start_node_num_);
@@ -688,12 +920,13 @@ void LoudsSparse::Iter::moveToRightMostKey() {
   }
 
   level_t level = key_len_ - 1;
-  position_t pos = pos_in_trie_[level];
+  position_t pos = path_.positions()[level];
   label_t label = trie_->labels_->read(pos);
 
   if (!trie_->child_indicator_bits_->readBit(pos)) {
     if ((label == kTerminator) && !trie_->isEndofNode(pos))
       is_at_terminator_ = true;
+    rankValuePosition(pos);
     is_valid_ = true;
     return;
   }
@@ -707,6 +940,7 @@ void LoudsSparse::Iter::moveToRightMostKey() {
       append(label, pos);
       if ((label == kTerminator) && !trie_->isEndofNode(pos))
         is_at_terminator_ = true;
+      rankValuePosition(pos);
       is_valid_ = true;
       return;
     }
@@ -717,27 +951,54 @@ void LoudsSparse::Iter::moveToRightMostKey() {
 }
 
 uint64_t LoudsSparse::Iter::getValue() const {
-  return trie_->values_sparse_[value_pos_[key_len_ - 1]];
+  return trie_->values_sparse_->read(path_.valuePositions()[key_len_ - 1]);
 }
 
 uint64_t LoudsSparse::Iter::getLastIteratorPosition() const {
-  return pos_in_trie_[key_len_ - 1];
+  return path_.positions()[key_len_ - 1];
 };
 
+std::string_view LoudsSparse::Iter::getSuffix() const {
+  return trie_->suffixes_sparse_->read(path_.valuePositions()[key_len_ - 1]);
+}
+
+bool LoudsSparse::Iter::isErased() const {
+  return trie_->tombstones_->readBit(path_.valuePositions()[key_len_ - 1]);
+}
+
 void LoudsSparse::Iter::rankValuePosition(size_t pos) {
-  if (value_pos_initialized_[key_len_ - 1]) {
-    value_pos_[key_len_ - 1]++;
+  if (path_.valuePositionsInitialized()[key_len_ - 1]) {
+    path_.valuePositions()[key_len_ - 1]++;
   } else {
-    value_pos_initialized_[key_len_ - 1] = true;
+    path_.valuePositionsInitialized()[key_len_ - 1] = true;
     uint64_t value_pos = pos - trie_->child_indicator_bits_->rank(pos);
-    value_pos_[key_len_ - 1] = value_pos;
+    path_.valuePositions()[key_len_ - 1] = value_pos;
   }
 }
 
+level_t LoudsSparse::Iter::commonPathLength(std::string_view key) const {
+  if (!is_valid_) return 0;
+  level_t len = 0;
+  // only inner nodes are kept, the walk continues in their child
+  while (len < key_len_ && start_level_ + len < key.length() &&
+      path_.keys()[len] == (label_t) key[start_level_ + len] &&
+      trie_->child_indicator_bits_->readBit(path_.positions()[len]))
+    len++;
+  return len;
+}
+
+void LoudsSparse::Iter::truncate(const level_t len) {
+  assert(len <= key_len_);
+  is_valid_ = false;
+  key_len_ = len;
+  is_at_terminator_ = false;
+  path_.clearValuePositions();
+}
+
 void LoudsSparse::Iter::operator++(int) {
   assert(key_len_ > 0);
   is_at_terminator_ = false;
-  position_t pos = pos_in_trie_[key_len_ - 1];
+  position_t pos = path_.positions()[key_len_ - 1];
   pos++;
   // trie_->louds_bits_ is set for last label in a node -> node terminates here
   while (pos >= trie_->louds_bits_->numBits() ||
@@ -747,7 +1008,7 @@ void LoudsSparse::Iter::operator++(int) {
       is_valid_ = false;
       return;
     }
-    pos = pos_in_trie_[key_len_ - 1];
+    pos = path_.positions()[key_len_ - 1];
     pos++;
   }
 
@@ -758,7 +1019,7 @@ void LoudsSparse::Iter::operator++(int) {
 void LoudsSparse::Iter::operator--(int) {
   assert(key_len_ > 0);
   is_at_terminator_ = false;
-  position_t pos = pos_in_trie_[key_len_ - 1];
+  position_t pos = path_.positions()[key_len_ - 1];
   if (pos == 0) {
     is_valid_ = false;
     return;
@@ -769,7 +1030,7 @@ void LoudsSparse::Iter::operator--(int) {
       is_valid_ = false;
       return;
     }
-    pos = pos_in_trie_[key_len_ - 1];
+    pos = path_.positions()[key_len_ - 1];
   }
   pos--;
   set(key_len_ - 1, pos);
@@ -27,6 +27,7 @@ class BitvectorRank : public Bitvector {
   }
 
   ~BitvectorRank() {
+    if (!owns_memory_) return;
     delete[] bits_;
     delete[] rank_lut_;
   }
@@ -89,6 +90,7 @@ class BitvectorRank : public Bitvector {
         const_cast<position_t *>(reinterpret_cast<const position_t *>(src));
     src += bv_rank->rankLutSize();
     align(src);
+    bv_rank->owns_memory_ = false;
     return bv_rank;
   }
 
@@ -0,0 +1,236 @@
+#ifndef RANKINTERLEAVED_H_
+#define RANKINTERLEAVED_H_
+
+#include <cassert>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "bitvector.hpp"
+#include "rank.hpp"
+
+namespace fst {
+
+// Rank structure that interleaves the rank counts with the bits: every
+// 64-byte line holds the number of 1's before the line in its first word,
+// followed by kDataWordsPerLine words of bits. A rank thus touches a single
+// cache line instead of the look-up table and the bit words.
+// Provides the interface of BitvectorRank that is used by the tries.
+class BitvectorRankInterleaved : private Bitvector {
+ public:
+  static const position_t kWordsPerLine = 8;
+  static const position_t kDataWordsPerLine = kWordsPerLine - 1;
+
+  BitvectorRankInterleaved() : num_lines_(0), lines_(nullptr) {};
+
+  // basic_block_size is accepted for compatibility with BitvectorRank; the
+  // basic block is always one line
+  BitvectorRankInterleaved(const position_t /* basic_block_size */,
+                           const std::vector<std::vector<word_t> > &bitvector_per_level,
+                           const std::vector<position_t> &num_bits_per_level,
+                           const level_t start_level = 0,
+                           const level_t end_level = 0 /* non-inclusive */)
+      : Bitvector(bitvector_per_level, num_bits_per_level, start_level,
+                  end_level) {
+    initLines();
+  }
+
+  ~BitvectorRankInterleaved() {
+    if (owns_memory_) operator delete[](lines_, std::align_val_t(kLineSize));
+  }
+
+  using Bitvector::numBits;
+
+  position_t rank(position_t pos) const {
+    assert(pos < num_bits_);
+    const position_t word_id = pos / kWordSize;
+    const word_t *line = lines_ + (word_id / kDataWordsPerLine) * kWordsPerLine;
+    const position_t last = word_id % kDataWordsPerLine + 1;
+    position_t count = line[0];
+    for (position_t i = 1; i < last; i++) count += __builtin_popcountll(line[i]);
+    return count + __builtin_popcountll(line[last] >> (kWordSize - 1 - pos % kWordSize));
+  }
+
+  bool readBit(position_t pos) const {
+    assert(pos < num_bits_);
+    return word(pos / kWordSize) & (kMsbMask >> (pos % kWordSize));
+  }
+
+  void prefetch(position_t pos) const {
+    __builtin_prefetch(lines_ + wordIndex(pos / kWordSize));
+  }
+
+  position_t distanceToNextSetBit(position_t pos) const;
+  position_t distanceToPrevSetBit(position_t pos) const;
+
+  size_t getNumSetBitsInDenseNode(position_t nodeNumber, unsigned &label) const;
+
+  // in bytes
+  position_t linesSize() const { return num_lines_ * kWordsPerLine * sizeof(word_t); }
+
+  // the lines, 64-byte aligned unless deserialized from a buffer that is
+  // aligned differently than the one serialized into
+  const word_t *lines() const { return lines_; }
+
+  // The lines are preceded by the number of padding bytes in front of them,
+  // which align them to 64 bytes; the padding behind them keeps the size
+  // independent of the alignment.
+  position_t serializedSize() const {
+    position_t size = sizeof(num_bits_) + sizeof(num_lines_);
+    sizeAlign(size);
+    size += kLineSize + linesSize();
+    sizeAlign(size);
+    return size;
+  }
+
+  position_t size() const override {
+    return (sizeof(BitvectorRankInterleaved) + linesSize());
+  }
+
+  void serialize(char *&dst) const {
+    memcpy(dst, &num_bits_, sizeof(num_bits_));
+    dst += sizeof(num_bits_);
+    memcpy(dst, &num_lines_, sizeof(num_lines_));
+    dst += sizeof(num_lines_);
+    align(dst);
+    const uint64_t padding = linePadding(dst + sizeof(uint64_t));
+    memcpy(dst, &padding, sizeof(padding));
+    dst += sizeof(padding) + padding;
+    memcpy(dst, lines_, linesSize());
+    dst += linesSize() + (kLineSize - sizeof(padding) - padding);
+    align(dst);
+  }
+
+  // The lines are used in place. They are cache line aligned, so that a
+  // rank touches a single line, if src is aligned like the buffer that was
+  // serialized into; FST::writeTo and FST::open keep the alignment.
+  static std::unique_ptr<BitvectorRankInterleaved> deSerialize(char *&src) {
+    auto bv_rank = std::make_unique<BitvectorRankInterleaved>();
+    memcpy(&(bv_rank->num_bits_), src, sizeof(bv_rank->num_bits_));
+    src += sizeof(bv_rank->num_bits_);
+    memcpy(&(bv_rank->num_lines_), src, sizeof(bv_rank->num_lines_));
+    src += sizeof(bv_rank->num_lines_);
+    align(src);
+    uint64_t padding = 0;
+    memcpy(&padding, src, sizeof(padding));
+    src += sizeof(padding) + padding;
+    bv_rank->lines_ = reinterpret_cast<word_t *>(src);
+    src += bv_rank->linesSize() + (kLineSize - sizeof(padding) - padding);
+    align(src);
+    bv_rank->owns_memory_ = false;
+    return bv_rank;
+  }
+
+ private:
+  static const size_t kLineSize = kWordsPerLine * sizeof(word_t);
+
+  // bytes from the word aligned ptr to the next line boundary
+  static uint64_t linePadding(const char *ptr) {
+    return (kLineSize - reinterpret_cast<uintptr_t>(ptr) % kLineSize) % kLineSize;
+  }
+
+  static position_t wordIndex(position_t word_id) {
+    return (word_id / kDataWordsPerLine) * kWordsPerLine + 1 +
+        word_id % kDataWordsPerLine;
+  }
+
+  word_t word(position_t word_id) const { return lines_[wordIndex(word_id)]; }
+
+  // Moves the bits built by Bitvector into the lines and releases them.
+  void initLines() {
+    const position_t num_words = numWords();
+    // one more line keeps rank(num_bits_ - 1) and prefetch in bounds
+    num_lines_ = num_words / kDataWordsPerLine + 1;
+    lines_ = new (std::align_val_t(kLineSize)) word_t[num_lines_ * kWordsPerLine]();
+
+    position_t cumu_rank = 0;
+    for (position_t i = 0; i < num_words; i++) {
+      if (i % kDataWordsPerLine == 0)
+        lines_[(i / kDataWordsPerLine) * kWordsPerLine] = cumu_rank;
+      lines_[wordIndex(i)] = bits_[i];
+      cumu_rank += __builtin_popcountll(bits_[i]);
+    }
+    if (num_words % kDataWordsPerLine == 0)
+      lines_[(num_words / kDataWordsPerLine) * kWordsPerLine] = cumu_rank;
+
+    delete[] bits_;
+    bits_ = nullptr;
+  }
+
+  position_t num_lines_;
+  word_t *lines_;
+};
+
+position_t BitvectorRankInterleaved::distanceToNextSetBit(const position_t pos) const {
+  assert(pos < num_bits_);
+  position_t distance = 1;
+
+  position_t word_id = (pos + 1) / kWordSize;
+  position_t offset = (pos + 1) % kWordSize;
+
+  // first word left-over bits
+  word_t test_bits = word(word_id) << offset;
+  if (test_bits > 0) {
+    return (distance + __builtin_clzll(test_bits));
+  } else {
+    if (word_id == numWords() - 1) return (num_bits_ - pos);
+    distance += (kWordSize - offset);
+  }
+
+  while (word_id < numWords() - 1) {
+    word_id++;
+    test_bits = word(word_id);
+    if (test_bits > 0) return (distance + __builtin_clzll(test_bits));
+    distance += kWordSize;
+  }
+  // no set bit follows: the distance ends at the last bit
+  return (num_bits_ - pos);
+}
+
+position_t BitvectorRankInterleaved::distanceToPrevSetBit(const position_t pos) const {
+  assert(pos <= num_bits_);
+  if (pos == 0) return 0;
+  position_t distance = 1;
+
+  position_t word_id = (pos - 1) / kWordSize;
+  position_t offset = (pos - 1) % kWordSize;
+
+  // first word left-over bits
+  word_t test_bits = word(word_id) >> (kWordSize - 1 - offset);
+  if (test_bits > 0) {
+    return (distance + __builtin_ctzll(test_bits));
+  } else {
+    distance += (offset + 1);
+  }
+
+  while (word_id > 0) {
+    word_id--;
+    test_bits = word(word_id);
+    if (test_bits > 0) return (distance + __builtin_ctzll(test_bits));
+    distance += kWordSize;
+  }
+  return distance;
+}
+
+size_t BitvectorRankInterleaved::getNumSetBitsInDenseNode(position_t nodeNumber,
+                                                          unsigned &label) const {
+  int setBits = 0;
+  for (auto i = 0; i < 4; i++) {
+    const word_t bits = word(nodeNumber * (kFanout / kWordSize) + i);
+    setBits += __builtin_popcountll(bits);
+    if (bits > 0) label = __builtin_clzll(bits) + kWordSize * i;
+  }
+  return setBits;
+}
+
+// rank structure of the LOUDS-Dense bitmaps and the LOUDS-Sparse
+// child indicator bits
+#ifdef FST_INTERLEAVED_RANK
+using RankVector = BitvectorRankInterleaved;
+#else
+using RankVector = BitvectorRank;
+#endif
+
+}  // namespace fst
+
+#endif  // RANKINTERLEAVED_H_
@@ -1,6 +1,9 @@
 #ifndef SELECT_H_
 #define SELECT_H_
 
+#include <immintrin.h>
+
+#include <algorithm>
 #include <cassert>
 #include <vector>
 
@@ -10,9 +13,40 @@
 
 namespace fst {
 
+#ifndef __BMI2__
+inline bool cpuSupportsBmi2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("bmi2");
+}
+
+static const bool kCpuSupportsBmi2 = cpuSupportsBmi2();
+
+__attribute__((target("bmi2")))
+inline position_t selectInWordPdep(word_t word, position_t rank) {
+  return kWordSize - 1 -
+      __builtin_ctzll(_pdep_u64(1ULL << (popcount(word) - rank), word));
+}
+#endif
+
+// Returns the position of the rank-th 1 bit in word, counted from the most
+// significant bit. Uses PDEP if the CPU supports BMI2.
+// REQUIRED: 0 < rank <= popcount(word)
+inline position_t selectInWord(word_t word, position_t rank) {
+#ifdef __BMI2__
+  // the rank-th 1 from the msb is the (popcount - rank)-th 1 from the lsb
+  return kWordSize - 1 -
+      __builtin_ctzll(_pdep_u64(1ULL << (popcount(word) - rank), word));
+#else
+  if (kCpuSupportsBmi2) return selectInWordPdep(word, rank);
+  return select64_popcount_search(word, rank);
+#endif
+}
+
 class BitvectorSelect : public Bitvector {
  public:
-  BitvectorSelect() : sample_interval_(0), num_ones_(0), select_lut_(nullptr){};
+  BitvectorSelect()
+      : sample_interval_(0), num_ones_(0), select_lut_(nullptr),
+        block_lut_(nullptr){};
 
   BitvectorSelect(const position_t sample_interval,
                   const std::vector<std::vector<word_t> > &bitvector_per_level,
@@ -23,62 +57,90 @@ class BitvectorSelect : public Bitvector {
                   end_level) {
     sample_interval_ = sample_interval;
     initSelectLut();
+    initBlockLut();
   }
 
   ~BitvectorSelect() {
+    if (!owns_memory_) return;
     delete[] bits_;
     delete[] select_lut_;
+    delete[] block_lut_;
   };
 
   // Returns the postion of the rank-th 1 bit.
   // posistion is zero-based; rank is one-based.
   // E.g., for bitvector: 100101000, select(3) = 5
+  // The select samples around rank bound the blocks that can hold the bit;
+  // the block look-up table is binary searched between them, so that at
+  // most the words of one block (a cache line) are scanned. The search is
+  // logarithmic in the number of blocks between two samples, which is 1
+  // unless the bitvector is sparse.
   position_t select(position_t rank) const {
     assert(rank > 0);
     assert(rank <= num_ones_);
-    position_t lut_idx = rank / sample_interval_;
-    position_t rank_left = rank % sample_interval_;
     // The first slot in select_lut_ stores the position of the first 1 bit.
     // Slot i > 0 stores the position of (i * sample_interval_)-th 1 bit
-    if (lut_idx == 0) rank_left--;
-
-    position_t pos = select_lut_[lut_idx];
-
-    if (rank_left == 0) return pos;
-
-    position_t word_id = pos / kWordSize;
-    position_t offset = pos % kWordSize;
-    if (offset == kWordSize - 1) {
-      word_id++;
-      offset = 0;
-    } else {
-      offset++;
+    const position_t sample = rank / sample_interval_;
+    position_t block_id = select_lut_[sample] / kBlockSize;
+    if (block_lut_[block_id + 1] < rank) {
+      // the next sample's block holds the bit or comes after it
+      const position_t last_block_id =
+          sample + 1 <= num_ones_ / sample_interval_
+              ? select_lut_[sample + 1] / kBlockSize : numBlocks() - 1;
+      block_id = std::lower_bound(block_lut_ + block_id + 2,
+                                  block_lut_ + last_block_id + 1, rank) -
+          block_lut_ - 1;
     }
-    word_t word =
-        bits_[word_id] << offset >> offset;  // zero-out most significant bits
-    position_t ones_count_in_word = popcount(word);
+
+    position_t rank_left = rank - block_lut_[block_id];
+    position_t word_id = block_id * kWordsPerBlock;
+    position_t ones_count_in_word = popcount(bits_[word_id]);
     while (ones_count_in_word < rank_left) {
-      word_id++;
-      word = bits_[word_id];
       rank_left -= ones_count_in_word;
-      ones_count_in_word = popcount(word);
+      word_id++;
+      ones_count_in_word = popcount(bits_[word_id]);
     }
-    return (word_id * kWordSize + select64_popcount_search(word, rank_left));
+    return (word_id * kWordSize + selectInWord(bits_[word_id], rank_left));
+  }
+
+  // Prefetches the select sample covering the rank-th 1 bit.
+  void prefetchSample(position_t rank) const {
+    __builtin_prefetch(select_lut_ + rank / sample_interval_);
+  }
+
+  // Prefetches the block the select scan for rank starts at.
+  // The sample should be cached already (see prefetchSample).
+  void prefetchWord(position_t rank) const {
+    const position_t block_id = select_lut_[rank / sample_interval_] / kBlockSize;
+    __builtin_prefetch(block_lut_ + block_id);
+    __builtin_prefetch(bits_ + block_id * kWordsPerBlock);
   }
 
   position_t selectLutSize() const {
     return ((num_ones_ / sample_interval_ + 1) * sizeof(position_t));
   }
 
+  position_t numBlocks() const {
+    return (numWords() + kWordsPerBlock - 1) / kWordsPerBlock;
+  }
+
+  // the last entry holds num_ones_
+  position_t blockLutSize() const {
+    return ((numBlocks() + 1) * sizeof(position_t));
+  }
+
   position_t serializedSize() const {
-    position_t size = sizeof(num_bits_) + sizeof(sample_interval_) +
-                      sizeof(num_ones_) + bitsSize() + selectLutSize();
+    position_t size =
+        sizeof(num_bits_) + sizeof(sample_interval_) + sizeof(num_ones_);
+    sizeAlign(size);  // bits_ are word aligned
+    size += bitsSize() + selectLutSize() + blockLutSize();
     sizeAlign(size);
     return size;
   }
 
   position_t size() const override {
-    return (sizeof(BitvectorSelect) + bitsSize() + selectLutSize());
+    return (sizeof(BitvectorSelect) + bitsSize() + selectLutSize() +
+        blockLutSize());
   }
 
   position_t numOnes() const { return num_ones_; }
@@ -90,10 +152,13 @@ class BitvectorSelect : public Bitvector {
     dst += sizeof(sample_interval_);
     memcpy(dst, &num_ones_, sizeof(num_ones_));
     dst += sizeof(num_ones_);
+    align(dst);
     memcpy(dst, bits_, bitsSize());
     dst += bitsSize();
     memcpy(dst, select_lut_, selectLutSize());
     dst += selectLutSize();
+    memcpy(dst, block_lut_, blockLutSize());
+    dst += blockLutSize();
     align(dst);
   }
 
@@ -106,13 +171,18 @@ class BitvectorSelect : public Bitvector {
     src += sizeof(bv_select->sample_interval_);
     memcpy(&(bv_select->num_ones_), src, sizeof(bv_select->num_ones_));
     src += sizeof(bv_select->num_ones_);
+    align(src);
     bv_select->bits_ =
         const_cast<word_t *>(reinterpret_cast<const word_t *>(src));
     src += bv_select->bitsSize();
     bv_select->select_lut_ =
         const_cast<position_t *>(reinterpret_cast<const position_t *>(src));
     src += bv_select->selectLutSize();
+    bv_select->block_lut_ =
+        const_cast<position_t *>(reinterpret_cast<const position_t *>(src));
+    src += bv_select->blockLutSize();
     align(src);
+    bv_select->owns_memory_ = false;
     return bv_select;
   }
 
@@ -132,7 +202,7 @@ class BitvectorSelect : public Bitvector {
       while (sampling_ones <= (cumu_ones_upto_word + num_ones_in_word)) {
         int diff = sampling_ones - cumu_ones_upto_word;
         position_t result_pos =
-            i * kWordSize + select64_popcount_search(bits_[i], diff);
+            i * kWordSize + selectInWord(bits_[i], diff);
         select_lut_vector.push_back(result_pos);
         sampling_ones += sample_interval_;
       }
@@ -146,10 +216,28 @@ class BitvectorSelect : public Bitvector {
       select_lut_[i] = select_lut_vector[i];
   }
 
+  void initBlockLut() {
+    const position_t num_blocks = numBlocks();
+    block_lut_ = new position_t[num_blocks + 1];
+    position_t cumu_ones = 0;
+    for (position_t i = 0; i < num_blocks; i++) {
+      block_lut_[i] = cumu_ones;
+      for (position_t j = i * kWordsPerBlock;
+           j < std::min((i + 1) * kWordsPerBlock, numWords()); j++)
+        cumu_ones += popcount(bits_[j]);
+    }
+    block_lut_[num_blocks] = cumu_ones;
+  }
+
  private:
+  static const position_t kBlockSize = 512;
+  static const position_t kWordsPerBlock = kBlockSize / kWordSize;
+
   position_t sample_interval_;
   position_t num_ones_{};
   position_t *select_lut_{};  // select look-up table
+  // number of 1's before each block of kBlockSize bits
+  position_t *block_lut_{};
 };
 
 }  // namespace fst
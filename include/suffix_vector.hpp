@@ -0,0 +1,122 @@
+#ifndef SUFFIXVECTOR_H_
+#define SUFFIXVECTOR_H_
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "config.hpp"
+
+namespace fst {
+
+// Stores the key bytes that follow the unique prefix of each key, i.e. the
+// part of the key that is truncated from the trie. Suffixes are packed
+// contiguously and indexed by value position. The offsets are positions, so
+// without FST_WIDE_POSITION the suffixes of the dense or the sparse levels are
+// limited to 4 GiB; FSTBuilder throws std::length_error beyond.
+class SuffixVector {
+ public:
+  SuffixVector()
+      : num_suffixes_(0), num_bytes_(0), offsets_(nullptr), bytes_(nullptr),
+        owns_memory_(true) {};
+
+  // offsets holds the start of every suffix in bytes plus the end of the
+  // last one; an empty offsets vector stores no suffixes
+  SuffixVector(const std::vector<position_t> &offsets,
+               const std::vector<char> &bytes)
+      : num_suffixes_(offsets.empty() ? 0 : offsets.size() - 1),
+        num_bytes_(bytes.size()), owns_memory_(true) {
+    offsets_ = new position_t[num_suffixes_ + 1]();
+    if (!offsets.empty())
+      memcpy(offsets_, offsets.data(), offsets.size() * sizeof(position_t));
+    bytes_ = new char[num_bytes_ + 1]();
+    if (num_bytes_ > 0) memcpy(bytes_, bytes.data(), num_bytes_);
+  }
+
+  ~SuffixVector() {
+    if (owns_memory_) {
+      delete[] offsets_;
+      delete[] bytes_;
+    }
+  }
+
+  position_t numSuffixes() const { return num_suffixes_; }
+
+  // in bytes
+  uint64_t offsetsSize() const { return (num_suffixes_ + 1) * sizeof(position_t); }
+
+  uint64_t bytesSize() const { return num_bytes_; }
+
+  uint64_t serializedSize() const {
+    uint64_t size = sizeof(num_suffixes_) + sizeof(num_bytes_);
+    sizeAlign(size);
+    size += offsetsSize();
+    sizeAlign(size);
+    size += bytesSize();
+    sizeAlign(size);
+    return size;
+  }
+
+  uint64_t size() const { return (sizeof(SuffixVector) + offsetsSize() + bytesSize()); }
+
+  std::string_view read(const position_t pos) const {
+    if (num_suffixes_ == 0) return std::string_view();
+    return std::string_view(bytes_ + offsets_[pos], offsets_[pos + 1] - offsets_[pos]);
+  }
+
+  // Compares suffix pos with the bytes of a key that follow its unique
+  // prefix. Without stored suffixes, the unique prefix identifies the key
+  // and 0 is returned.
+  int compare(const position_t pos, const std::string_view key_suffix) const {
+    if (num_suffixes_ == 0) return 0;
+    return read(pos).compare(key_suffix);
+  }
+
+  void prefetch(const position_t pos) const {
+    if (num_suffixes_ == 0) return;
+    __builtin_prefetch(offsets_ + pos);
+  }
+
+  void serialize(char *&dst) const {
+    memcpy(dst, &num_suffixes_, sizeof(num_suffixes_));
+    dst += sizeof(num_suffixes_);
+    memcpy(dst, &num_bytes_, sizeof(num_bytes_));
+    dst += sizeof(num_bytes_);
+    align(dst);
+    memcpy(dst, offsets_, offsetsSize());
+    dst += offsetsSize();
+    align(dst);
+    memcpy(dst, bytes_, bytesSize());
+    dst += bytesSize();
+    align(dst);
+  }
+
+  // The returned vector points into src, which must outlive it.
+  static std::unique_ptr<SuffixVector> deSerialize(char *&src) {
+    auto sv = std::make_unique<SuffixVector>();
+    memcpy(&(sv->num_suffixes_), src, sizeof(sv->num_suffixes_));
+    src += sizeof(sv->num_suffixes_);
+    memcpy(&(sv->num_bytes_), src, sizeof(sv->num_bytes_));
+    src += sizeof(sv->num_bytes_);
+    align(src);
+    sv->offsets_ = reinterpret_cast<position_t *>(src);
+    src += sv->offsetsSize();
+    align(src);
+    sv->bytes_ = src;
+    src += sv->bytesSize();
+    align(src);
+    sv->owns_memory_ = false;
+    return sv;
+  }
+
+ private:
+  position_t num_suffixes_;
+  uint64_t num_bytes_;
+  position_t *offsets_;  // num_suffixes_ + 1 entries
+  char *bytes_;
+  bool owns_memory_;  // false if the arrays point into a serialized buffer
+};
+
+}  // namespace fst
+
+#endif  // SUFFIXVECTOR_H_
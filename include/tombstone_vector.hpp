@@ -0,0 +1,118 @@
+#ifndef TOMBSTONEVECTOR_H_
+#define TOMBSTONEVECTOR_H_
+
+#include <atomic>
+#include <memory>
+
+#include "config.hpp"
+
+namespace fst {
+
+// Marks erased keys, indexed by value position. The bits are allocated when
+// the first key is erased and set atomically, so that keys can be erased
+// while other threads read the trie. Lookups check a single pointer as long
+// as no key has been erased.
+class TombstoneVector {
+ public:
+  explicit TombstoneVector(position_t num_bits = 0)
+      : num_bits_(num_bits), words_(nullptr) {}
+
+  ~TombstoneVector() { delete[] words_.load(std::memory_order_acquire); }
+
+  TombstoneVector(const TombstoneVector &) = delete;
+  TombstoneVector &operator=(const TombstoneVector &) = delete;
+
+  position_t numBits() const { return num_bits_; }
+
+  // false as long as no key has been erased
+  bool hasSetBits() const {
+    return words_.load(std::memory_order_acquire) != nullptr;
+  }
+
+  bool readBit(const position_t pos) const {
+    const std::atomic<word_t> *words = words_.load(std::memory_order_acquire);
+    if (words == nullptr) return false;
+    return words[pos / kWordSize].load(std::memory_order_relaxed) &
+        (kMsbMask >> (pos % kWordSize));
+  }
+
+  // returns false if the bit was set before
+  bool setBit(const position_t pos) {
+    assert(pos < num_bits_);
+    const word_t mask = kMsbMask >> (pos % kWordSize);
+    return !(allocate()[pos / kWordSize].fetch_or(mask, std::memory_order_relaxed) & mask);
+  }
+
+  uint64_t numWords() const { return (num_bits_ + kWordSize - 1) / kWordSize; }
+
+  // in bytes, without bits if no key has been erased
+  uint64_t bitsSize() const {
+    return words_.load(std::memory_order_acquire) == nullptr ? 0 : numWords() * sizeof(word_t);
+  }
+
+  uint64_t serializedSize() const {
+    uint64_t size = sizeof(num_bits_) + sizeof(uint64_t);
+    sizeAlign(size);
+    size += bitsSize();
+    return size;
+  }
+
+  uint64_t size() const { return (sizeof(TombstoneVector) + bitsSize()); }
+
+  void serialize(char *&dst) const {
+    memcpy(dst, &num_bits_, sizeof(num_bits_));
+    dst += sizeof(num_bits_);
+    const std::atomic<word_t> *words = words_.load(std::memory_order_acquire);
+    const uint64_t num_words = words == nullptr ? 0 : numWords();
+    memcpy(dst, &num_words, sizeof(num_words));
+    dst += sizeof(num_words);
+    align(dst);
+    for (uint64_t i = 0; i < num_words; i++) {
+      const word_t word = words[i].load(std::memory_order_relaxed);
+      memcpy(dst, &word, sizeof(word));
+      dst += sizeof(word);
+    }
+  }
+
+  // Unlike the other vectors, the bits are copied out of src: keys erased
+  // after loading must not be written into a mapped file.
+  static std::unique_ptr<TombstoneVector> deSerialize(char *&src) {
+    auto tv = std::make_unique<TombstoneVector>();
+    memcpy(&(tv->num_bits_), src, sizeof(tv->num_bits_));
+    src += sizeof(tv->num_bits_);
+    uint64_t num_words = 0;
+    memcpy(&num_words, src, sizeof(num_words));
+    src += sizeof(num_words);
+    align(src);
+    if (num_words > 0) {
+      std::atomic<word_t> *words = tv->allocate();
+      for (uint64_t i = 0; i < num_words; i++) {
+        word_t word;
+        memcpy(&word, src, sizeof(word));
+        src += sizeof(word);
+        words[i].store(word, std::memory_order_relaxed);
+      }
+    }
+    return tv;
+  }
+
+ private:
+  std::atomic<word_t> *allocate() {
+    std::atomic<word_t> *words = words_.load(std::memory_order_acquire);
+    if (words != nullptr) return words;
+    auto *created = new std::atomic<word_t>[numWords()];
+    for (uint64_t i = 0; i < numWords(); i++) created[i].store(0, std::memory_order_relaxed);
+    // another thread may have allocated the bits in the meantime
+    if (words_.compare_exchange_strong(words, created, std::memory_order_acq_rel))
+      return created;
+    delete[] created;
+    return words;
+  }
+
+  position_t num_bits_;
+  std::atomic<std::atomic<word_t> *> words_;
+};
+
+}  // namespace fst
+
+#endif  // TOMBSTONEVECTOR_H_
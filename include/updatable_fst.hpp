@@ -0,0 +1,348 @@
+#ifndef UPDATABLEFST_H_
+#define UPDATABLEFST_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "config.hpp"
+#include "fst.hpp"
+
+namespace fst {
+
+// An FST that accepts inserts and erases. Writes go to a small sorted delta,
+// lookups and iterators merge the delta with the FST. Once the delta holds
+// delta_limit keys, it is frozen and a background thread builds a new FST
+// from the current one and the frozen delta, while new writes go to a fresh
+// delta. Readers keep a reference to the FST version they started with, so a
+// replaced FST is freed when its last reader is done (RCU-style).
+// Like for FST, no key may be a prefix of another key.
+class UpdatableFST {
+ public:
+  class Iter;
+
+  UpdatableFST(const std::vector<std::string> &keys,
+               const std::vector<uint64_t> &values,
+               size_t delta_limit = kDeltaLimit);
+
+  // waits for a running rebuild
+  ~UpdatableFST() { waitForRebuild(); }
+
+  UpdatableFST(const UpdatableFST &) = delete;
+  UpdatableFST &operator=(const UpdatableFST &) = delete;
+
+  // inserts key, or replaces its value
+  void insert(const std::string &key, uint64_t value);
+
+  void erase(const std::string &key);
+
+  bool lookupKey(std::string_view key, uint64_t &value) const;
+
+  // The iterator sees the writes before the seek; it copies the delta
+  // entries behind key, i.e. up to delta_limit keys.
+  UpdatableFST::Iter moveToKeyGreaterThan(std::string_view key,
+                                          bool inclusive) const;
+
+  UpdatableFST::Iter moveToFirst() const;
+
+  // Starts a background rebuild with the current delta, unless the delta is
+  // empty or a rebuild is running.
+  void rebuild();
+
+  // waits until a running rebuild has replaced the FST
+  void waitForRebuild();
+
+ private:
+  struct DeltaEntry {
+    uint64_t value;
+    bool is_erased;
+  };
+  // std::less<> finds string_view keys without a copy
+  using Delta = std::map<std::string, DeltaEntry, std::less<>>;
+
+  // An immutable FST and the frozen delta that is merged into its successor.
+  struct Version {
+    std::shared_ptr<const FST> fst;  // nullptr if there are no keys
+    // nullptr if no rebuild is running
+    std::shared_ptr<const Delta> frozen_delta;
+  };
+
+  // mutex_ must be held exclusively. Returns the previous rebuild thread,
+  // which the caller joins after releasing mutex_.
+  std::thread startRebuild();
+
+  void runRebuild(std::shared_ptr<const Version> version);
+
+  // the keys of fst with the writes of delta applied
+  static std::shared_ptr<const FST> build(const FST *fst, const Delta &delta);
+
+  const size_t delta_limit_;
+
+  // guards delta_ and version_
+  mutable std::shared_mutex mutex_;
+  Delta delta_;
+  std::shared_ptr<const Version> version_;
+
+  // guards rebuild_thread_
+  std::mutex rebuild_mutex_;
+  std::thread rebuild_thread_;
+};
+
+class UpdatableFST::Iter {
+ public:
+  Iter() = default;
+
+  bool isValid() const { return is_delta_ || fst_iter_.isValid(); }
+
+  // the complete key
+  const std::string &getKey() const {
+    return is_delta_ ? delta_[delta_pos_].first : fst_key_;
+  }
+
+  uint64_t getValue() const {
+    return is_delta_ ? delta_[delta_pos_].second.value : fst_iter_.getValue();
+  }
+
+  void operator++(int);
+
+ private:
+  void moveFstIter();
+
+  // moves to the next key that is neither replaced nor erased by the delta
+  void skipReplacedKeys();
+
+  std::shared_ptr<const Version> version_;
+  FST::Iter fst_iter_;
+  std::string fst_key_;  // complete key of fst_iter_
+  // the delta entries from the seek key on, with the active delta's entries
+  // replacing those of the frozen delta
+  std::vector<std::pair<std::string, DeltaEntry>> delta_;
+  size_t delta_pos_ = 0;
+  bool is_delta_ = false;  // the current key is delta_[delta_pos_]
+
+  friend class UpdatableFST;
+};
+
+UpdatableFST::UpdatableFST(const std::vector<std::string> &keys,
+                           const std::vector<uint64_t> &values,
+                           const size_t delta_limit)
+    : delta_limit_(delta_limit) {
+  auto version = std::make_shared<Version>();
+  // the iterators compare complete keys, which requires the suffixes
+  if (!keys.empty())
+    version->fst = std::make_shared<const FST>(keys, values, kIncludeDense,
+                                               kSparseDenseRatio, 1, true);
+  version_ = version;
+}
+
+void UpdatableFST::insert(const std::string &key, const uint64_t value) {
+  std::thread previous;
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    delta_[key] = {value, false};
+    if (delta_.size() >= delta_limit_) previous = startRebuild();
+  }
+  if (previous.joinable()) previous.join();
+}
+
+void UpdatableFST::erase(const std::string &key) {
+  std::thread previous;
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    delta_[key] = {0, true};
+    if (delta_.size() >= delta_limit_) previous = startRebuild();
+  }
+  if (previous.joinable()) previous.join();
+}
+
+bool UpdatableFST::lookupKey(std::string_view key, uint64_t &value) const {
+  std::shared_ptr<const Version> version;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto entry = delta_.find(key);
+    if (entry != delta_.end()) {
+      value = entry->second.value;
+      return !entry->second.is_erased;
+    }
+    version = version_;
+  }
+  if (version->frozen_delta != nullptr) {
+    auto entry = version->frozen_delta->find(key);
+    if (entry != version->frozen_delta->end()) {
+      value = entry->second.value;
+      return !entry->second.is_erased;
+    }
+  }
+  return version->fst != nullptr && version->fst->lookupKey(key, value);
+}
+
+UpdatableFST::Iter UpdatableFST::moveToKeyGreaterThan(std::string_view key,
+                                                      const bool inclusive) const {
+  UpdatableFST::Iter iter;
+  std::vector<std::pair<std::string, DeltaEntry>> active;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto begin = inclusive ? delta_.lower_bound(key) : delta_.upper_bound(key);
+    active.assign(begin, delta_.end());
+    iter.version_ = version_;
+  }
+
+  const Version &version = *iter.version_;
+  if (version.frozen_delta == nullptr) {
+    iter.delta_ = std::move(active);
+  } else {
+    const Delta &frozen = *version.frozen_delta;
+    auto entry = inclusive ? frozen.lower_bound(key) : frozen.upper_bound(key);
+    auto active_entry = active.begin();
+    while (entry != frozen.end() || active_entry != active.end()) {
+      if (active_entry == active.end() ||
+          (entry != frozen.end() && entry->first < active_entry->first)) {
+        iter.delta_.emplace_back(*entry++);
+        continue;
+      }
+      if (entry != frozen.end() && entry->first == active_entry->first) entry++;
+      iter.delta_.emplace_back(std::move(*active_entry++));
+    }
+  }
+
+  if (version.fst != nullptr) {
+    iter.fst_iter_ = key.empty() && inclusive
+                     ? version.fst->moveToFirst()
+                     : version.fst->moveToKeyGreaterThan(key, inclusive);
+    if (iter.fst_iter_.isValid()) {
+      iter.fst_key_.assign(iter.fst_iter_.keyView());
+      iter.fst_key_.append(iter.fst_iter_.getSuffix());
+    }
+  }
+  iter.skipReplacedKeys();
+  return iter;
+}
+
+UpdatableFST::Iter UpdatableFST::moveToFirst() const {
+  return moveToKeyGreaterThan(std::string_view(), true);
+}
+
+void UpdatableFST::rebuild() {
+  std::thread previous;
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    previous = startRebuild();
+  }
+  if (previous.joinable()) previous.join();
+}
+
+void UpdatableFST::waitForRebuild() {
+  std::thread thread;
+  {
+    std::lock_guard<std::mutex> guard(rebuild_mutex_);
+    thread = std::move(rebuild_thread_);
+  }
+  if (thread.joinable()) thread.join();
+}
+
+std::thread UpdatableFST::startRebuild() {
+  if (delta_.empty() || version_->frozen_delta != nullptr) return std::thread();
+
+  auto version = std::make_shared<Version>();
+  version->fst = version_->fst;
+  version->frozen_delta = std::make_shared<const Delta>(std::move(delta_));
+  delta_.clear();
+  version_ = version;
+
+  std::lock_guard<std::mutex> guard(rebuild_mutex_);
+  // The previous rebuild has already replaced the FST, but may still be
+  // freeing the old one; it is joined without holding mutex_.
+  std::thread previous = std::move(rebuild_thread_);
+  rebuild_thread_ = std::thread(&UpdatableFST::runRebuild, this, version);
+  return previous;
+}
+
+void UpdatableFST::runRebuild(std::shared_ptr<const Version> version) {
+  auto next = std::make_shared<Version>();
+  next->fst = build(version->fst.get(), *version->frozen_delta);
+  std::shared_ptr<const Version> previous;
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    previous = std::move(version_);
+    version_ = next;
+  }
+  // previous and version are released outside of the lock; the old FST is
+  // freed here unless readers still use it
+}
+
+std::shared_ptr<const FST> UpdatableFST::build(const FST *fst,
+                                               const Delta &delta) {
+  // the merged keys are streamed into the builder, so that only the trie
+  // levels and not a copy of every key are held during a rebuild
+  FSTBuilder builder(kIncludeDense, kSparseDenseRatio, true);
+  bool is_empty = true;
+  FST::Iter iter;
+  if (fst != nullptr) iter = fst->moveToFirst();
+  std::string key;
+  auto entry = delta.begin();
+  while (iter.isValid() || entry != delta.end()) {
+    if (iter.isValid()) {
+      key.assign(iter.keyView());
+      key.append(iter.getSuffix());
+      if (entry == delta.end() || key < entry->first) {
+        builder.add(key, iter.getValue());
+        is_empty = false;
+        iter++;
+        continue;
+      }
+      // replaced or erased by the delta
+      if (key == entry->first) iter++;
+    }
+    if (!entry->second.is_erased) {
+      builder.add(entry->first, entry->second.value);
+      is_empty = false;
+    }
+    entry++;
+  }
+  if (is_empty) return nullptr;
+  builder.finish();
+  return std::make_shared<const FST>(builder);
+}
+
+void UpdatableFST::Iter::operator++(int) {
+  if (is_delta_)
+    delta_pos_++;
+  else
+    moveFstIter();
+  skipReplacedKeys();
+}
+
+void UpdatableFST::Iter::moveFstIter() {
+  fst_iter_++;
+  if (fst_iter_.isValid()) {
+    fst_key_.assign(fst_iter_.keyView());
+    fst_key_.append(fst_iter_.getSuffix());
+  }
+}
+
+void UpdatableFST::Iter::skipReplacedKeys() {
+  for (; delta_pos_ < delta_.size(); delta_pos_++) {
+    const auto &entry = delta_[delta_pos_];
+    if (fst_iter_.isValid()) {
+      const int cmp = fst_key_.compare(entry.first);
+      if (cmp < 0) break;  // the FST's key comes first
+      if (cmp == 0) moveFstIter();
+    }
+    if (!entry.second.is_erased) {
+      is_delta_ = true;
+      return;
+    }
+  }
+  is_delta_ = false;
+}
+
+}  // namespace fst
+
+#endif  // UPDATABLEFST_H_
@@ -0,0 +1,257 @@
+#ifndef VALUEVECTOR_H_
+#define VALUEVECTOR_H_
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "config.hpp"
+
+namespace fst {
+
+// Stores the values of the trie leaves, indexed by value position, in one
+// of the following encodings:
+// kPlain: one 64-bit word per value
+// kBitPacked: every value with the bit width of the largest value
+// kFrameOfReference: blocks of kValueBlockSize values, each stored as the
+//   difference to the smallest value of its block with the bit width of the
+//   largest difference; suits the value runs of monotone tuple ids
+// kAuto picks the smallest of them at construction time.
+// All encodings provide O(1) access.
+class ValueVector {
+ public:
+  ValueVector()
+      : num_values_(0), encoding_(ValueEncoding::kPlain), width_(0),
+        num_words_(0), blocks_(nullptr), words_(nullptr), owns_memory_(true) {};
+
+  explicit ValueVector(const std::vector<uint64_t> &values,
+                       ValueEncoding encoding = kValueEncoding)
+      : num_values_(values.size()), width_(0), num_words_(0),
+        blocks_(nullptr), words_(nullptr), owns_memory_(true) {
+    if (encoding == ValueEncoding::kAuto) encoding = chooseEncoding(values);
+    encoding_ = encoding;
+    switch (encoding_) {
+      case ValueEncoding::kBitPacked:
+        encodeBitPacked(values);
+        break;
+      case ValueEncoding::kFrameOfReference:
+        encodeFrameOfReference(values);
+        break;
+      default:
+        encoding_ = ValueEncoding::kPlain;
+        num_words_ = num_values_;
+        words_ = new uint64_t[num_words_ + 1]();
+        if (num_values_ > 0)
+          memcpy(words_, values.data(), num_values_ * sizeof(uint64_t));
+    }
+  }
+
+  ~ValueVector() {
+    if (owns_memory_) {
+      delete[] blocks_;
+      delete[] words_;
+    }
+  }
+
+  position_t numValues() const { return num_values_; }
+
+  ValueEncoding getEncoding() const { return encoding_; }
+
+  // in bytes
+  uint64_t valuesSize() const {
+    return (numBlocks() * 2 + num_words_) * sizeof(uint64_t);
+  }
+
+  uint64_t serializedSize() const {
+    uint64_t size = sizeof(num_values_) + sizeof(encoding_) + sizeof(width_);
+    sizeAlign(size);
+    size += sizeof(num_words_) + valuesSize();
+    sizeAlign(size);
+    return size;
+  }
+
+  uint64_t size() const { return (sizeof(ValueVector) + valuesSize()); }
+
+  uint64_t read(const position_t pos) const {
+    switch (encoding_) {
+      case ValueEncoding::kBitPacked:
+        return readBits((uint64_t) pos * width_, width_);
+      case ValueEncoding::kFrameOfReference: {
+        const uint64_t *block = blocks_ + 2 * (pos / kValueBlockSize);
+        const uint8_t width = block[1] & 0xff;
+        return block[0] +
+            readBits((block[1] >> 8) + (pos % kValueBlockSize) * width, width);
+      }
+      default:
+        return words_[pos];
+    }
+  }
+
+  uint64_t operator[](const position_t pos) const { return read(pos); }
+
+  void prefetch(const position_t pos) const {
+    switch (encoding_) {
+      case ValueEncoding::kBitPacked:
+        __builtin_prefetch(words_ + ((uint64_t) pos * width_) / kWordSize);
+        break;
+      case ValueEncoding::kFrameOfReference:
+        __builtin_prefetch(blocks_ + 2 * (pos / kValueBlockSize));
+        break;
+      default:
+        __builtin_prefetch(words_ + pos);
+    }
+  }
+
+  void serialize(char *&dst) const {
+    memcpy(dst, &num_values_, sizeof(num_values_));
+    dst += sizeof(num_values_);
+    memcpy(dst, &encoding_, sizeof(encoding_));
+    dst += sizeof(encoding_);
+    memcpy(dst, &width_, sizeof(width_));
+    dst += sizeof(width_);
+    align(dst);
+    memcpy(dst, &num_words_, sizeof(num_words_));
+    dst += sizeof(num_words_);
+    if (numBlocks() > 0) {
+      memcpy(dst, blocks_, numBlocks() * 2 * sizeof(uint64_t));
+      dst += numBlocks() * 2 * sizeof(uint64_t);
+    }
+    memcpy(dst, words_, num_words_ * sizeof(uint64_t));
+    dst += num_words_ * sizeof(uint64_t);
+    align(dst);
+  }
+
+  // The returned vector points into src, which must outlive it.
+  static std::unique_ptr<ValueVector> deSerialize(char *&src) {
+    auto vv = std::make_unique<ValueVector>();
+    memcpy(&(vv->num_values_), src, sizeof(vv->num_values_));
+    src += sizeof(vv->num_values_);
+    memcpy(&(vv->encoding_), src, sizeof(vv->encoding_));
+    src += sizeof(vv->encoding_);
+    memcpy(&(vv->width_), src, sizeof(vv->width_));
+    src += sizeof(vv->width_);
+    align(src);
+    memcpy(&(vv->num_words_), src, sizeof(vv->num_words_));
+    src += sizeof(vv->num_words_);
+    vv->owns_memory_ = false;
+    if (vv->numBlocks() > 0) vv->blocks_ = reinterpret_cast<uint64_t *>(src);
+    src += vv->numBlocks() * 2 * sizeof(uint64_t);
+    vv->words_ = reinterpret_cast<uint64_t *>(src);
+    src += vv->num_words_ * sizeof(uint64_t);
+    align(src);
+    return vv;
+  }
+
+ private:
+  // number of frame-of-reference blocks, 0 for the other encodings
+  position_t numBlocks() const {
+    if (encoding_ != ValueEncoding::kFrameOfReference) return 0;
+    return (num_values_ + kValueBlockSize - 1) / kValueBlockSize;
+  }
+
+  static uint8_t bitWidth(const uint64_t value) {
+    return value == 0 ? 0 : kWordSize - __builtin_clzll(value);
+  }
+
+  static uint64_t numWords(const uint64_t num_bits) {
+    return (num_bits + kWordSize - 1) / kWordSize;
+  }
+
+  static ValueEncoding chooseEncoding(const std::vector<uint64_t> &values);
+
+  void encodeBitPacked(const std::vector<uint64_t> &values);
+
+  void encodeFrameOfReference(const std::vector<uint64_t> &values);
+
+  // bits are stored starting at the least significant bit of each word
+  uint64_t readBits(const uint64_t offset, const uint8_t width) const {
+    if (width == 0) return 0;
+    const uint64_t word_id = offset / kWordSize;
+    const uint64_t shift = offset % kWordSize;
+    uint64_t bits = words_[word_id] >> shift;
+    if (shift + width > kWordSize)
+      bits |= words_[word_id + 1] << (kWordSize - shift);
+    return width == kWordSize ? bits : bits & ((1ULL << width) - 1);
+  }
+
+  void writeBits(uint64_t offset, uint64_t value, uint8_t width);
+
+ private:
+  position_t num_values_;
+  ValueEncoding encoding_;
+  uint8_t width_;  // bit width of the kBitPacked encoding
+  uint64_t num_words_;
+  // kFrameOfReference: per block, the base value followed by
+  // (bit offset of the block in words_ << 8 | bit width)
+  uint64_t *blocks_;
+  uint64_t *words_;
+  bool owns_memory_;  // false if the arrays point into a serialized buffer
+};
+
+ValueEncoding ValueVector::chooseEncoding(const std::vector<uint64_t> &values) {
+  uint64_t max_value = 0;
+  for (uint64_t value : values) max_value |= value;
+  const uint64_t bit_packed_words = numWords(values.size() * bitWidth(max_value));
+
+  uint64_t for_bits = 0;
+  for (size_t begin = 0; begin < values.size(); begin += kValueBlockSize) {
+    const size_t end = std::min<size_t>(begin + kValueBlockSize, values.size());
+    auto minmax = std::minmax_element(values.begin() + begin, values.begin() + end);
+    for_bits += (end - begin) * bitWidth(*minmax.second - *minmax.first);
+  }
+  const uint64_t num_blocks = (values.size() + kValueBlockSize - 1) / kValueBlockSize;
+  const uint64_t for_words = 2 * num_blocks + numWords(for_bits);
+
+  if (values.size() <= bit_packed_words && values.size() <= for_words)
+    return ValueEncoding::kPlain;
+  if (bit_packed_words <= for_words) return ValueEncoding::kBitPacked;
+  return ValueEncoding::kFrameOfReference;
+}
+
+void ValueVector::encodeBitPacked(const std::vector<uint64_t> &values) {
+  uint64_t max_value = 0;
+  for (uint64_t value : values) max_value |= value;
+  width_ = bitWidth(max_value);
+  num_words_ = numWords((uint64_t) num_values_ * width_);
+  words_ = new uint64_t[num_words_ + 1]();
+  for (position_t pos = 0; pos < num_values_; pos++)
+    writeBits((uint64_t) pos * width_, values[pos], width_);
+}
+
+void ValueVector::encodeFrameOfReference(const std::vector<uint64_t> &values) {
+  const position_t num_blocks = numBlocks();
+  blocks_ = new uint64_t[2 * num_blocks + 1]();
+  uint64_t num_bits = 0;
+  for (position_t block = 0; block < num_blocks; block++) {
+    const size_t begin = (size_t) block * kValueBlockSize;
+    const size_t end = std::min<size_t>(begin + kValueBlockSize, num_values_);
+    auto minmax = std::minmax_element(values.begin() + begin, values.begin() + end);
+    const uint8_t width = bitWidth(*minmax.second - *minmax.first);
+    blocks_[2 * block] = *minmax.first;
+    blocks_[2 * block + 1] = (num_bits << 8) | width;
+    num_bits += (end - begin) * width;
+  }
+
+  num_words_ = numWords(num_bits);
+  words_ = new uint64_t[num_words_ + 1]();
+  for (position_t pos = 0; pos < num_values_; pos++) {
+    const uint64_t *block = blocks_ + 2 * (pos / kValueBlockSize);
+    const uint8_t width = block[1] & 0xff;
+    writeBits((block[1] >> 8) + (pos % kValueBlockSize) * width,
+              values[pos] - block[0], width);
+  }
+}
+
+void ValueVector::writeBits(const uint64_t offset, const uint64_t value,
+                            const uint8_t width) {
+  if (width == 0) return;
+  const uint64_t word_id = offset / kWordSize;
+  const uint64_t shift = offset % kWordSize;
+  words_[word_id] |= value << shift;
+  if (shift + width > kWordSize)
+    words_[word_id + 1] |= value >> (kWordSize - shift);
+}
+
+}  // namespace fst
+
+#endif  // VALUEVECTOR_H_
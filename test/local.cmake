@@ -16,6 +16,24 @@ endfunction()
 add_unit_test(test/test_fst_example test_example)
 add_unit_test(test/test_fst_example_words test_example_words)
 add_unit_test(test/test_fst_ints test_int32)
+add_unit_test(test/test_fst_serialize test_serialize)
+add_unit_test(test/test_fst_builder test_builder)
+add_unit_test(test/test_value_vector test_value_vector)
+add_unit_test(test/test_rank test_rank)
+add_unit_test(test/test_select test_select)
+add_unit_test(test/test_label_vector test_label_vector)
+add_unit_test(test/test_updatable_fst test_updatable_fst)
+add_unit_test(test/test_int_fst test_int_fst)
+
+# the trie tests once more with the interleaved rank layout
+add_unit_test(test/test_fst_serialize test_serialize_interleaved_rank)
+target_compile_definitions(test_serialize_interleaved_rank PRIVATE FST_INTERLEAVED_RANK)
+
+# ... and with 64-bit positions
+add_unit_test(test/test_fst_serialize test_serialize_wide_position)
+target_compile_definitions(test_serialize_wide_position PRIVATE FST_WIDE_POSITION)
+add_unit_test(test/test_select test_select_wide_position)
+target_compile_definitions(test_select_wide_position PRIVATE FST_WIDE_POSITION)
 
 
 # ---------------------------------------------------------------------------
@@ -0,0 +1,170 @@
+#include "gtest/gtest.h"
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "config.hpp"
+#include "fst.hpp"
+
+namespace fst {
+
+namespace surftest {
+
+static const std::string kFilePath = "keys.txt";
+static const uint32_t kNumIntKeys = 250000;
+// spreads the integer keys over all possible first bytes
+static const uint32_t kIntKeySkip = 16777;
+
+class SuRFBuilderTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    uint32_t key = 3;
+    for (uint32_t i = 0; i < kNumIntKeys; i++) {
+      keys_int32.emplace_back(uint32ToString(key));
+      values_int32.emplace_back(i);
+      key += kIntKeySkip;
+    }
+
+    std::ifstream infile(kFilePath);
+    std::string word;
+    while (infile >> word) {
+      keys_words.emplace_back(word);
+      values_words.emplace_back(keys_words.size());
+    }
+  }
+
+  void TearDown() override {}
+
+  // two tries are equal if their serializations are
+  static void assertEqualTries(const FST &expected, const FST &actual) {
+    ASSERT_EQ(expected.serializedSize(), actual.serializedSize());
+    std::unique_ptr<char[]> expected_data(expected.serialize());
+    std::unique_ptr<char[]> actual_data(actual.serialize());
+    ASSERT_EQ(0, memcmp(expected_data.get(), actual_data.get(), expected.serializedSize()));
+  }
+
+  std::vector<std::string> keys_int32;
+  std::vector<uint64_t> values_int32;
+  std::vector<std::string> keys_words;
+  std::vector<uint64_t> values_words;
+};
+
+TEST_F (SuRFBuilderTest, ParallelBuildTest) {
+  FST sequential(keys_int32, values_int32, kIncludeDense, kSparseDenseRatio);
+  for (unsigned num_threads : {2, 3, 8, 64}) {
+    FST parallel(keys_int32, values_int32, kIncludeDense, kSparseDenseRatio, num_threads);
+    assertEqualTries(sequential, parallel);
+  }
+
+  FST parallel(keys_int32, values_int32, kIncludeDense, kSparseDenseRatio, 4);
+  for (size_t i = 0; i < keys_int32.size(); i++) {
+    uint64_t value = 0;
+    ASSERT_TRUE(parallel.lookupKey(keys_int32[i], value));
+    ASSERT_EQ(values_int32[i], value);
+  }
+}
+
+TEST_F (SuRFBuilderTest, ParallelBuildSinglePartitionTest) {
+  // all keys start with the same byte, i.e. the key list cannot be split
+  FST sequential(keys_words, values_words, kIncludeDense, kSparseDenseRatio);
+  FST parallel(keys_words, values_words, kIncludeDense, kSparseDenseRatio, 4);
+  assertEqualTries(sequential, parallel);
+}
+
+TEST_F (SuRFBuilderTest, StreamingBuildTest) {
+  for (bool include_dense : {false, true}) {
+    FST expected(keys_words, values_words, include_dense, kSparseDenseRatio);
+    FSTBuilder builder(include_dense, kSparseDenseRatio);
+    for (size_t i = 0; i < keys_words.size(); i++) {
+      builder.add(keys_words[i], values_words[i]);
+      builder.add(keys_words[i], 0);  // duplicates keep the first value
+    }
+    builder.finish();
+    FST streamed(builder);
+    assertEqualTries(expected, streamed);
+
+    for (size_t i = 0; i < keys_words.size(); i++) {
+      uint64_t value = 0;
+      ASSERT_TRUE(streamed.lookupKey(keys_words[i], value));
+      ASSERT_EQ(values_words[i], value);
+    }
+  }
+}
+
+TEST_F (SuRFBuilderTest, StreamingBuildWithoutKeysTest) {
+  FSTBuilder builder(true, kSparseDenseRatio);
+  ASSERT_THROW(builder.finish(), std::logic_error);
+}
+
+TEST_F (SuRFBuilderTest, LookupCostCutoffTest) {
+  // URL-like keys: a shared prefix above a wide level of 200 hosts with 50
+  // pages each
+  std::vector<std::string> keys;
+  std::vector<uint64_t> values;
+  for (int host = 0; host < 200; host++) {
+    for (int page = 0; page < 50; page++) {
+      keys.emplace_back(std::string("www.") + char(20 + host) + char(20 + page) + "/index");
+      values.emplace_back(keys.size());
+    }
+  }
+
+  FSTBuilder size_ratio(true, kSparseDenseRatio);
+  size_ratio.build(keys, values);
+  FSTBuilder lookup_cost(true, kSparseDenseRatio);
+  lookup_cost.setCutoffPolicy(CutoffPolicy::kLookupCost);
+  lookup_cost.build(keys, values);
+  // the host and page levels are encoded as bitmaps
+  ASSERT_LT(size_ratio.getSparseStartLevel(), 5u);
+  ASSERT_GE(lookup_cost.getSparseStartLevel(), 6u);
+
+  FST fst(lookup_cost);
+  for (size_t i = 0; i < keys.size(); i++) {
+    uint64_t value = 0;
+    ASSERT_TRUE(fst.lookupKey(keys[i], value));
+    ASSERT_EQ(values[i], value);
+  }
+  uint64_t value = 0;
+  ASSERT_FALSE(fst.lookupKey(std::string("www.") + char(10) + "x", value));
+
+  // a ratio of 0 places no limit on the dense levels
+  FSTBuilder unlimited(true, 0);
+  unlimited.setCutoffPolicy(CutoffPolicy::kLookupCost);
+  unlimited.build(keys, values);
+  ASSERT_EQ(unlimited.getTreeHeight(), unlimited.getSparseStartLevel());
+  FST unlimited_fst(unlimited);
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_TRUE(unlimited_fst.lookupKey(keys[i], value));
+    ASSERT_EQ(values[i], value);
+  }
+
+  // the integer keys spread over 65536 narrow nodes on the last level, whose
+  // bitmaps would not fit into the cache even without a size limit
+  FSTBuilder narrow(true, 0);
+  narrow.setCutoffPolicy(CutoffPolicy::kLookupCost);
+  narrow.build(keys_int32, values_int32);
+  ASSERT_GT(narrow.getSparseStartLevel(), 0u);
+  ASSERT_LT(narrow.getSparseStartLevel(), narrow.getTreeHeight());
+  FST narrow_fst(narrow);
+  for (size_t i = 0; i < keys_int32.size(); i++) {
+    ASSERT_TRUE(narrow_fst.lookupKey(keys_int32[i], value));
+    ASSERT_EQ(values_int32[i], value);
+  }
+
+  FSTBuilder words(true, kSparseDenseRatio);
+  words.setCutoffPolicy(CutoffPolicy::kLookupCost);
+  words.build(keys_words, values_words);
+  FST words_fst(words);
+  for (size_t i = 0; i < keys_words.size(); i++) {
+    ASSERT_TRUE(words_fst.lookupKey(keys_words[i], value));
+    ASSERT_EQ(values_words[i], value);
+  }
+}
+
+} // namespace surftest
+
+} // namespace fst
+
+int main(int argc, char *argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,10 +1,14 @@
 #include "gtest/gtest.h"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include "config.hpp"
 #include "fst.hpp"
 #include <chrono>
 #include <fstream>
+#include <random>
+#include <set>
+#include <stdexcept>
 
 namespace fst {
 
@@ -111,6 +115,509 @@ TEST_F (SuRFExampleWords, IteratorTest1) {
   size_t surf_mib = surf->getMemoryUsage() / (1024 * 1024);
   std::cout << surf_mib << " MiB" << std::endl;
 }
+TEST_F (SuRFExampleWords, BatchedLookupTest) {
+  FST *surf = new FST(keys, values_uint64, kIncludeDense, 16);
+
+  // mix existing keys with keys that do not exist in the trie
+  std::vector<std::string> lookup_keys;
+  for (const auto &key : keys) {
+    lookup_keys.emplace_back(key);
+    lookup_keys.emplace_back(key + "~");
+    lookup_keys.emplace_back(key.substr(0, key.size() / 2));
+  }
+
+  std::vector<uint64_t> values(lookup_keys.size(), 0);
+  std::unique_ptr<bool[]> found(new bool[lookup_keys.size()]);
+  surf->lookupKeys(lookup_keys.data(), lookup_keys.size(), values.data(), found.get());
+
+  for (size_t i = 0; i < lookup_keys.size(); i++) {
+    uint64_t value = 0;
+    bool exist = surf->lookupKey(lookup_keys[i], value);
+    ASSERT_EQ(exist, found[i]);
+    if (exist) {
+      ASSERT_EQ(value, values[i]);
+    }
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_TRUE(found[3 * i]);
+    ASSERT_EQ(values_uint64[i], values[3 * i]);
+  }
+  delete surf;
+}
+
+TEST_F (SuRFExampleWords, SuffixStoreTest) {
+  // the trie must not depend on the key list after the build
+  std::vector<std::string> build_keys(keys);
+  FST surf(build_keys, values_uint64, kIncludeDense, 16);
+  build_keys.clear();
+  build_keys.shrink_to_fit();
+
+  std::set<std::string> key_set(keys.begin(), keys.end());
+  for (size_t i = 0; i < keys.size(); i++) {
+    // same unique prefix, different tail
+    std::string probe = keys[i];
+    probe.back()++;
+    uint64_t value = 0;
+    ASSERT_EQ(key_set.count(probe) > 0, surf.lookupKey(probe, value));
+
+    auto iter = surf.moveToKeyGreaterThan(keys[i], true);
+    ASSERT_TRUE(iter.isValid());
+    ASSERT_EQ(keys[i], iter.getFullKey());
+    ASSERT_EQ(values_uint64[i], iter.getValue());
+
+    iter = surf.moveToKeyGreaterThan(keys[i], false);
+    if (i + 1 < keys.size()) {
+      ASSERT_TRUE(iter.isValid());
+      ASSERT_EQ(keys[i + 1], iter.getFullKey());
+    }
+  }
+
+  auto iter = surf.moveToFirst();
+  for (size_t i = 0; i < keys.size(); i++, iter++) {
+    ASSERT_TRUE(iter.isValid());
+    ASSERT_EQ(keys[i], iter.getFullKey());
+  }
+
+  // without suffixes, only the unique prefixes are stored
+  FST prefixes(keys, values_uint64, kIncludeDense, 16, 1, false);
+  ASSERT_LT(prefixes.serializedSize(), surf.serializedSize());
+  for (size_t i = 0; i < keys.size(); i++) {
+    uint64_t value = 0;
+    ASSERT_TRUE(prefixes.lookupKey(keys[i], value));
+    ASSERT_EQ(values_uint64[i], value);
+  }
+}
+
+TEST_F (SuRFExampleWords, KeyViewTest) {
+  // a trie higher than kIterInlineHeight keeps the iterator path on the heap
+  std::vector<std::string> long_keys;
+  for (size_t i = 0; i < keys.size(); i++)
+    long_keys.emplace_back(std::string(kIterInlineHeight + 12, 'a') + keys[i]);
+
+  for (const auto *key_list : {&keys, &long_keys}) {
+    FST surf(*key_list, values_uint64, kIncludeDense, 16);
+    auto iter = surf.moveToFirst();
+    for (size_t i = 0; i < key_list->size(); i++, iter++) {
+      ASSERT_TRUE(iter.isValid());
+      ASSERT_EQ(iter.getKey(), iter.keyView());
+      ASSERT_EQ(0u, (*key_list)[i].compare(0, iter.keyView().size(), iter.keyView()));
+    }
+
+    for (size_t i = 0; i < key_list->size(); i += 7) {
+      auto seek = surf.moveToKeyGreaterThan((*key_list)[i], true);
+      // copies must not share the key buffer
+      auto copy = seek;
+      seek++;
+      ASSERT_EQ(copy.getValue(), values_uint64[i]);
+      ASSERT_EQ(0u, (*key_list)[i].compare(0, copy.keyView().size(), copy.keyView()));
+    }
+  }
+}
+
+TEST_F (SuRFExampleWords, SeekTest) {
+  // probes between and on the keys, in ascending and in random order
+  std::vector<std::string> probes;
+  for (const auto &key : keys) {
+    probes.emplace_back(key);
+    std::string between = key;
+    between.back()++;
+    probes.emplace_back(between);
+    probes.emplace_back(key.substr(0, key.size() / 2));
+  }
+  std::sort(probes.begin(), probes.end());
+  std::vector<std::string> shuffled(probes);
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(7));
+
+  for (const bool include_dense : {true, false}) {
+    FST surf(keys, values_uint64, include_dense, 16);
+    for (const auto *probe_list : {&probes, &shuffled}) {
+      for (const bool inclusive : {true, false}) {
+        auto iter = surf.moveToFirst();
+        for (const auto &probe : *probe_list) {
+          surf.seek(iter, probe, inclusive);
+          auto expected = surf.moveToKeyGreaterThan(probe, inclusive);
+          // the reused iterator must also continue like a fresh one
+          for (int step = 0; step < 3; step++, iter++, expected++) {
+            ASSERT_EQ(expected.isValid(), iter.isValid());
+            if (!expected.isValid()) break;
+            ASSERT_EQ(expected.getFullKey(), iter.getFullKey());
+            ASSERT_EQ(expected.getValue(), iter.getValue());
+          }
+          surf.seek(iter, probe, inclusive);
+        }
+      }
+    }
+
+    // 0xff probes end at the last label of their node
+    for (const std::string &probe : {std::string("\xff"), keys[0].substr(0, 1) + "\xff",
+                                     keys[1000].substr(0, 2) + "\xff", keys.back().substr(0, 1) + "\xff"}) {
+      const auto expected = std::lower_bound(keys.begin(), keys.end(), probe);
+      for (const bool inclusive : {true, false}) {
+        auto iter = surf.moveToKeyGreaterThan(probe, inclusive);
+        ASSERT_EQ(expected != keys.end(), iter.isValid());
+        if (iter.isValid()) {
+          ASSERT_EQ(*expected, iter.getFullKey());
+        }
+      }
+    }
+  }
+}
+
+// collects the output of FST::scan
+class VectorSink : public ScanSink {
+ public:
+  explicit VectorSink(bool with_keys) : with_keys_(with_keys) {}
+
+  bool wantsKeys() const override { return with_keys_; }
+
+  void consume(const uint64_t *values, const char *key_bytes,
+               const uint32_t *key_offsets, size_t num_keys) override {
+    ASSERT_LE(num_keys, kScanBlockSize);
+    num_blocks++;
+    for (size_t i = 0; i < num_keys; i++) {
+      this->values.push_back(values[i]);
+      if (with_keys_)
+        keys.emplace_back(key_bytes + key_offsets[i], key_offsets[i + 1] - key_offsets[i]);
+    }
+  }
+
+  std::vector<uint64_t> values;
+  std::vector<std::string> keys;
+  size_t num_blocks = 0;
+
+ private:
+  bool with_keys_;
+};
+
+TEST_F (SuRFExampleWords, ScanTest) {
+  for (const bool include_dense : {true, false}) {
+    FST surf(keys, values_uint64, include_dense, 16);
+
+    // whole key set, in several blocks
+    VectorSink all(true);
+    ASSERT_EQ(keys.size(), surf.scan("", std::string(1, (char) 0x7f), SIZE_MAX, all));
+    ASSERT_EQ(keys, all.keys);
+    ASSERT_EQ(values_uint64, all.values);
+    ASSERT_EQ((keys.size() + kScanBlockSize - 1) / kScanBlockSize, all.num_blocks);
+
+    for (size_t begin = 0; begin < keys.size(); begin += 97) {
+      const size_t end = std::min(keys.size() - 1, begin + 1500);
+      // [keys[begin], keys[end]) holds end - begin keys
+      VectorSink range(true);
+      ASSERT_EQ(end - begin, surf.scan(keys[begin], keys[end], SIZE_MAX, range));
+      ASSERT_EQ(std::vector<std::string>(keys.begin() + begin, keys.begin() + end), range.keys);
+
+      VectorSink limited(false);
+      ASSERT_EQ(std::min<size_t>(10, end - begin), surf.scan(keys[begin], keys[end], 10, limited));
+      ASSERT_TRUE(limited.keys.empty());
+      ASSERT_EQ(std::vector<uint64_t>(values_uint64.begin() + begin,
+                                      values_uint64.begin() + begin + limited.values.size()),
+                limited.values);
+    }
+
+    // bounds that are not in the key set
+    for (size_t i = 0; i + 300 < keys.size(); i += 131) {
+      std::string left = keys[i];
+      left.back()++;
+      std::string right = keys[i + 300].substr(0, 1);
+      right.back()++;
+      auto first = std::lower_bound(keys.begin(), keys.end(), left);
+      auto last = std::lower_bound(keys.begin(), keys.end(), right);
+      VectorSink range(true);
+      ASSERT_EQ((size_t) (last - first), surf.scan(left, right, SIZE_MAX, range));
+      ASSERT_EQ(std::vector<std::string>(first, last), range.keys);
+    }
+
+    VectorSink empty(false);
+    ASSERT_EQ(0u, surf.scan(keys[10], keys[10], SIZE_MAX, empty));
+    ASSERT_EQ(0u, surf.scan(keys[200], keys[100], SIZE_MAX, empty));
+    ASSERT_EQ(0u, empty.num_blocks);
+  }
+}
+
+TEST_F (SuRFExampleWords, RankTest) {
+  std::vector<std::string> probes = {"", std::string(1, (char) 0xff)};
+  for (const auto &key : keys) {
+    probes.emplace_back(key);
+    std::string between = key;
+    between.back()++;
+    probes.emplace_back(between);
+    probes.emplace_back(key.substr(0, key.size() / 2));
+  }
+
+  for (const bool include_dense : {true, false}) {
+    FST surf(keys, values_uint64, include_dense, 16);
+    for (const auto &probe : probes) {
+      const auto expected = std::lower_bound(keys.begin(), keys.end(), probe) - keys.begin();
+      ASSERT_EQ((uint64_t) expected, surf.rankOf(probe)) << probe;
+    }
+    for (size_t i = 0; i + 1 < probes.size(); i += 3) {
+      const auto &left = probes[i];
+      const auto &right = probes[i + 1];
+      const auto expected = left < right ?
+          std::lower_bound(keys.begin(), keys.end(), right) - std::lower_bound(keys.begin(), keys.end(), left) : 0;
+      ASSERT_EQ((uint64_t) expected, surf.countRange(left, right));
+    }
+  }
+}
+
+TEST_F (SuRFExampleWords, OrdinalTest) {
+  for (const bool include_dense : {true, false}) {
+    FST surf(keys, values_uint64, include_dense, 16);
+    ASSERT_EQ(keys.size(), surf.getNumKeys());
+    for (size_t i = 0; i < keys.size(); i++) {
+      auto iter = surf.atOrdinal(i);
+      ASSERT_TRUE(iter.isValid());
+      ASSERT_EQ(keys[i], iter.getFullKey());
+      ASSERT_EQ(values_uint64[i], iter.getValue());
+      ASSERT_EQ(i, surf.rankOf(iter.getFullKey()));
+    }
+    ASSERT_FALSE(surf.atOrdinal(keys.size()).isValid());
+  }
+}
+
+TEST_F (SuRFExampleWords, PartitionRangeTest) {
+  for (const bool include_dense : {true, false}) {
+    FST surf(keys, values_uint64, include_dense, 16);
+    const std::vector<std::pair<std::string, std::string>> bounds = {
+        {"", std::string(1, (char) 0x7f)}, {keys[100], keys[3000]}, {keys[7], keys[9]}};
+    for (const auto &bound : bounds) {
+      const uint64_t num_keys = surf.countRange(bound.first, bound.second);
+      for (const size_t k : {1, 3, 8, 64}) {
+        const auto ranges = surf.partitionRange(bound.first, bound.second, k);
+        ASSERT_EQ(k, ranges.size());
+        ASSERT_EQ(bound.first, ranges.front().first);
+        ASSERT_EQ(bound.second, ranges.back().second);
+        for (size_t i = 0; i < k; i++) {
+          if (i > 0) {
+            ASSERT_EQ(ranges[i - 1].second, ranges[i].first);
+          }
+          const uint64_t count = surf.countRange(ranges[i].first, ranges[i].second);
+          ASSERT_TRUE(count == num_keys / k || count == num_keys / k + 1);
+        }
+
+        std::vector<VectorSink> sinks(k, VectorSink(true));
+        std::vector<ScanSink *> sink_ptrs;
+        for (auto &sink : sinks) sink_ptrs.push_back(&sink);
+        ASSERT_EQ(num_keys, surf.scanParallel(bound.first, bound.second, sink_ptrs));
+        std::vector<std::string> scanned;
+        for (const auto &sink : sinks)
+          scanned.insert(scanned.end(), sink.keys.begin(), sink.keys.end());
+        const auto first = std::lower_bound(keys.begin(), keys.end(), bound.first);
+        ASSERT_EQ(std::vector<std::string>(first, first + num_keys), scanned);
+      }
+    }
+    ASSERT_TRUE(surf.partitionRange(keys[5], keys[5], 0).empty());
+    ASSERT_EQ(0u, surf.countRange(keys[5], keys[4]));
+  }
+}
+
+TEST_F (SuRFExampleWords, EraseTest) {
+  for (const bool include_dense : {true, false}) {
+    FST surf(keys, values_uint64, include_dense, 16);
+    // every third key, the first and the last key
+    std::vector<std::string> remaining;
+    std::vector<uint64_t> remaining_values;
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (i % 3 == 0 || i + 1 == keys.size()) {
+        ASSERT_TRUE(surf.erase(keys[i]));
+        ASSERT_FALSE(surf.erase(keys[i]));
+      } else {
+        remaining.emplace_back(keys[i]);
+        remaining_values.emplace_back(values_uint64[i]);
+      }
+    }
+    std::string missing = keys[1];
+    missing.back()++;
+    ASSERT_FALSE(surf.erase(missing));
+
+    auto check = [&](const FST &fst) {
+      std::vector<uint64_t> values(keys.size());
+      std::unique_ptr<bool[]> found(new bool[keys.size()]);
+      fst.lookupKeys(keys.data(), keys.size(), values.data(), found.get());
+      for (size_t i = 0; i < keys.size(); i++) {
+        uint64_t value = 0;
+        const bool is_erased = i % 3 == 0 || i + 1 == keys.size();
+        ASSERT_EQ(!is_erased, fst.lookupKey(keys[i], value)) << keys[i];
+        ASSERT_EQ(!is_erased, found[i]) << keys[i];
+      }
+
+      size_t i = 0;
+      for (auto iter = fst.moveToFirst(); iter.isValid(); iter++, i++) {
+        ASSERT_LT(i, remaining.size());
+        ASSERT_EQ(remaining[i], iter.getFullKey());
+        ASSERT_EQ(remaining_values[i], iter.getValue());
+      }
+      ASSERT_EQ(remaining.size(), i);
+      for (auto iter = fst.moveToLast(); iter.isValid(); iter--) {
+        ASSERT_LT(0u, i);
+        ASSERT_EQ(remaining[--i], iter.getFullKey());
+      }
+      ASSERT_EQ(0u, i);
+
+      // seeks to erased keys move on to the next remaining key
+      for (size_t k = 0; k < keys.size(); k += 7) {
+        auto iter = fst.moveToKeyGreaterThan(keys[k], true);
+        auto expected = std::lower_bound(remaining.begin(), remaining.end(), keys[k]);
+        ASSERT_EQ(expected != remaining.end(), iter.isValid());
+        if (iter.isValid()) {
+          ASSERT_EQ(*expected, iter.getFullKey());
+        }
+      }
+
+      VectorSink all(true);
+      ASSERT_EQ(remaining.size(), fst.scan("", std::string(1, (char) 0x7f), SIZE_MAX, all));
+      ASSERT_EQ(remaining, all.keys);
+    };
+    check(surf);
+
+    // erased keys are serialized, and keys can be erased after loading
+    std::unique_ptr<char[]> data(surf.serialize());
+    std::unique_ptr<FST> copy(FST::deSerialize(data.get()));
+    ASSERT_EQ(surf.serializedSize(), copy->serializedSize());
+    check(*copy);
+    ASSERT_TRUE(copy->erase(remaining[0]));
+    uint64_t value = 0;
+    ASSERT_FALSE(copy->lookupKey(remaining[0], value));
+    ASSERT_TRUE(surf.lookupKey(remaining[0], value));
+  }
+}
+
+TEST_F (SuRFExampleWords, MergeTest) {
+  for (const bool include_dense : {true, false}) {
+    // the inputs overlap in every fifth key
+    std::vector<std::string> keys_a, keys_b;
+    std::vector<uint64_t> values_a, values_b;
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (i % 2 == 0 || i % 5 == 0) {
+        keys_a.emplace_back(keys[i]);
+        values_a.emplace_back(i);
+      }
+      if (i % 2 == 1 || i % 5 == 0) {
+        keys_b.emplace_back(keys[i]);
+        values_b.emplace_back(i + keys.size());
+      }
+    }
+    FST a(keys_a, values_a, include_dense, 16);
+    FST b(keys_b, values_b, include_dense, 16);
+    // erased keys are dropped
+    ASSERT_TRUE(a.erase(keys[4]));
+    ASSERT_TRUE(b.erase(keys[5]));
+
+    size_t num_resolved = 0;
+    auto merged = FST::merge(a, b, [&](std::string_view key, uint64_t value_a, uint64_t value_b) {
+      num_resolved++;
+      EXPECT_EQ(keys[value_a], key);
+      return value_a + value_b;
+    });
+    ASSERT_NE(nullptr, merged);
+    // keys[0], keys[10], keys[15], ... are in both inputs, keys[5] only in a
+    ASSERT_EQ((keys.size() + 4) / 5 - 1, num_resolved);
+
+    size_t i = 0;
+    for (auto iter = merged->moveToFirst(); iter.isValid(); iter++, i++) {
+      if (i == 4) i++;
+      ASSERT_EQ(keys[i], iter.getFullKey());
+      uint64_t expected = i % 2 == 0 || i == 5 ? i : i + keys.size();
+      if (i % 5 == 0 && i != 5) expected = 2 * i + keys.size();
+      ASSERT_EQ(expected, iter.getValue());
+    }
+    ASSERT_EQ(keys.size(), i);
+    ASSERT_EQ(keys.size() - 1, merged->getNumKeys());
+
+    // the iterators of a trie without suffixes return truncated keys
+    FST truncated(keys_b, values_b, include_dense, 16, 1, false);
+    ASSERT_FALSE(truncated.hasSuffixes());
+    auto sum = [](std::string_view, uint64_t value_a, uint64_t value_b) {
+      return value_a + value_b;
+    };
+    ASSERT_THROW(FST::merge(a, truncated, sum), std::invalid_argument);
+    ASSERT_THROW(FST::merge(truncated, a, sum), std::invalid_argument);
+  }
+}
+
+TEST_F (SuRFExampleWords, StringViewTest) {
+  FST surf(keys, values_uint64, kIncludeDense, 16);
+  // views into a single buffer, i.e. keys that are not null-terminated
+  std::string buffer;
+  for (const auto &key : keys) buffer.append(key);
+  std::vector<std::string_view> views;
+  size_t offset = 0;
+  for (const auto &key : keys) {
+    views.emplace_back(buffer.data() + offset, key.size());
+    offset += key.size();
+  }
+
+  std::vector<uint64_t> values(views.size());
+  std::unique_ptr<bool[]> found(new bool[views.size()]);
+  surf.lookupKeys(views.data(), views.size(), values.data(), found.get());
+  for (size_t i = 0; i < views.size(); i++) {
+    uint64_t value = 0;
+    ASSERT_TRUE(surf.lookupKey(views[i], value));
+    ASSERT_EQ(values_uint64[i], value);
+    ASSERT_TRUE(found[i]);
+    ASSERT_EQ(values_uint64[i], values[i]);
+
+    auto iter = surf.moveToKeyGreaterThan(views[i], false);
+    ASSERT_EQ(i + 1 < keys.size(), iter.isValid());
+    if (iter.isValid()) {
+      ASSERT_EQ(keys[i + 1], iter.getFullKey());
+    }
+    ASSERT_EQ(i, surf.rankOf(views[i]));
+  }
+  // a view of a key's prefix must not match the key
+  uint64_t value = 0;
+  ASSERT_FALSE(surf.lookupKey(views[0].substr(0, views[0].size() - 1), value));
+}
+TEST_F (SuRFExampleWords, CursorTest) {
+  for (const bool include_dense : {true, false}) {
+    FST surf(keys, values_uint64, include_dense, 16);
+    surf.erase(keys[7]);
+    std::vector<std::string> sorted_keys = keys;
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+    // hand off after each prefix length, on dense and sparse levels
+    for (size_t prefix_length = 0; prefix_length < 4; prefix_length++) {
+      for (size_t i = 0; i < keys.size(); i += 13) {
+        if (keys[i].size() <= prefix_length) continue;
+        FST::Cursor cursor(&surf);
+        ASSERT_TRUE(cursor.descend(std::string_view(keys[i]).substr(0, prefix_length)));
+        if (cursor.isAtValue()) {
+          ASSERT_EQ(values_uint64[i], cursor.value());
+          continue;
+        }
+        ASSERT_EQ(prefix_length, cursor.getLevel());
+        ASSERT_EQ(prefix_length < surf.getSparseStartLevel(), cursor.isDense());
+
+        uint64_t value = 0;
+        ASSERT_EQ(i != 7, cursor.lookupKey(keys[i], value));
+        if (i != 7) {
+          ASSERT_EQ(values_uint64[i], value);
+        }
+        // a resumed cursor equals a descended one
+        FST::Cursor resumed(&surf, cursor.getLevel(), cursor.getNodeNum());
+        ASSERT_EQ(i != 7, resumed.lookupKey(keys[i], value));
+        std::string missing = keys[i] + "\x01";
+        ASSERT_FALSE(cursor.lookupKey(missing, value));
+
+        // the iterator covers the keys with the prefix from keys[i] on
+        auto iter = cursor.seekGE(keys[i]);
+        auto expected = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), keys[i]);
+        const std::string prefix = keys[i].substr(0, prefix_length);
+        for (; iter.isValid(); iter++, expected++) {
+          if (*expected == keys[7]) expected++;
+          ASSERT_NE(sorted_keys.end(), expected);
+          ASSERT_EQ(*expected, prefix + iter.getFullKey());
+        }
+        if (expected != sorted_keys.end() && *expected == keys[7]) expected++;
+        ASSERT_TRUE(expected == sorted_keys.end() || expected->compare(0, prefix_length, prefix) != 0);
+      }
+    }
+    FST::Cursor cursor(&surf);
+    ASSERT_FALSE(cursor.step(0));
+    ASSERT_FALSE(cursor.isValid());
+  }
+}
+
 } // namespace surftest
 
 } // namespace fst
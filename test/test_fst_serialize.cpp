@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "config.hpp"
+#include "fst.hpp"
+
+namespace fst {
+
+namespace surftest {
+
+static const std::string kFilePath = "keys.txt";
+static const std::string kFstPath = "test_fst_serialize.fst";
+static const int kTestSize = 4000;
+
+class SuRFSerializeTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    std::ifstream infile(kFilePath);
+    std::string key;
+    while (infile.good() && keys.size() < kTestSize) {
+      infile >> key;
+      keys.emplace_back(key);
+      values_uint64.emplace_back(keys.size() * 7);
+    }
+  }
+
+  void TearDown() override { std::remove(kFstPath.c_str()); }
+
+  void corruptByte(uint64_t offset) {
+    std::fstream file(kFstPath, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekg(offset);
+    char byte = 0;
+    file.read(&byte, 1);
+    byte ^= 0x5a;
+    file.seekp(offset);
+    file.write(&byte, 1);
+  }
+
+  std::vector<std::string> keys;
+  std::vector<uint64_t> values_uint64;
+};
+
+TEST_F (SuRFSerializeTest, SerializeDeSerializeTest) {
+  FST surf(keys, values_uint64, kIncludeDense, 16);
+  std::unique_ptr<char[]> data(surf.serialize());
+  std::unique_ptr<FST> loaded(FST::deSerialize(data.get()));
+
+  ASSERT_EQ(surf.serializedSize(), loaded->serializedSize());
+  for (size_t i = 0; i < keys.size(); i++) {
+    uint64_t value = 0;
+    ASSERT_TRUE(loaded->lookupKey(keys[i], value));
+    ASSERT_EQ(values_uint64[i], value);
+  }
+}
+
+TEST_F (SuRFSerializeTest, WriteToOpenTest) {
+  FST surf(keys, values_uint64, kIncludeDense, 16);
+  surf.writeTo(kFstPath);
+  auto loaded = FST::open(kFstPath);
+
+  ASSERT_EQ(surf.getHeight(), loaded->getHeight());
+  ASSERT_EQ(surf.getSparseStartLevel(), loaded->getSparseStartLevel());
+  for (size_t i = 0; i < keys.size(); i++) {
+    uint64_t value = 0;
+    ASSERT_TRUE(loaded->lookupKey(keys[i], value));
+    ASSERT_EQ(values_uint64[i], value);
+  }
+
+  // values are also served to iterators
+  auto iter = loaded->moveToFirst();
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_TRUE(iter.isValid());
+    ASSERT_EQ(values_uint64[i], iter.getValue());
+    iter++;
+  }
+  ASSERT_FALSE(iter.isValid());
+}
+
+TEST_F (SuRFSerializeTest, OpenInvalidFileTest) {
+  ASSERT_THROW(FST::open("does_not_exist.fst"), std::runtime_error);
+
+  FST surf(keys, values_uint64, kIncludeDense, 16);
+  surf.writeTo(kFstPath);
+
+  // magic
+  corruptByte(0);
+  ASSERT_THROW(FST::open(kFstPath), std::runtime_error);
+  corruptByte(0);
+  ASSERT_NO_THROW(FST::open(kFstPath));
+
+  // payload
+  corruptByte(sizeof(FileHeader) + surf.serializedSize() / 2);
+  ASSERT_THROW(FST::open(kFstPath), std::runtime_error);
+  ASSERT_NO_THROW(FST::open(kFstPath, false));
+
+  // truncated file
+  surf.writeTo(kFstPath);
+  std::string content;
+  {
+    std::ifstream in(kFstPath, std::ios::binary);
+    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream out(kFstPath, std::ios::binary | std::ios::trunc);
+    out.write(content.data(), content.size() - 8);
+  }
+  ASSERT_THROW(FST::open(kFstPath), std::runtime_error);
+}
+
+} // namespace surftest
+
+} // namespace fst
+
+int main(int argc, char *argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,166 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include "config.hpp"
+#include "int_fst.hpp"
+
+namespace fst {
+
+namespace surftest {
+
+static const uint64_t kNumIntKeys = 20000;
+
+template <typename T>
+class IntFSTTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    std::mt19937_64 gen(7);
+    // random keys, and runs of consecutive keys that fill whole nodes
+    for (uint64_t i = 0; i < kNumIntKeys; i++) {
+      const T key = static_cast<T>(gen());
+      if (i % 16 == 0) {
+        for (T j = 0; j < 300; j++) keys.emplace_back(key + j);
+      } else {
+        keys.emplace_back(key);
+      }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    for (uint64_t i = 0; i < keys.size(); i++) values.emplace_back(i * 3);
+  }
+
+  void checkLookups(const IntFST<T> &fst) {
+    for (uint64_t i = 0; i < keys.size(); i++) {
+      uint64_t value = 0;
+      ASSERT_TRUE(fst.lookupKey(keys[i], value)) << i;
+      ASSERT_EQ(values[i], value);
+      // the next integer is a key only within a run
+      const bool exists = i + 1 < keys.size() && keys[i + 1] == T(keys[i] + 1);
+      ASSERT_EQ(exists, fst.lookupKey(T(keys[i] + 1), value)) << i;
+    }
+  }
+
+  std::vector<T> keys;
+  std::vector<uint64_t> values;
+};
+
+using IntTypes = ::testing::Types<uint32_t, uint64_t>;
+TYPED_TEST_SUITE(IntFSTTest, IntTypes);
+
+TYPED_TEST(IntFSTTest, SameTrieAsStringBuild) {
+  // addInteger must build the trie that the byte-wise build produces
+  const IntFST<TypeParam> int_fst(this->keys, this->values);
+  const FST fst(this->keys, this->values);
+  const uint64_t size = fst.serializedSize();
+  ASSERT_EQ(size, int_fst.getFST().serializedSize());
+  char *expected = fst.serialize();
+  char *data = int_fst.getFST().serialize();
+  ASSERT_EQ(0, memcmp(expected, data, size));
+  delete[] expected;
+  delete[] data;
+}
+
+TYPED_TEST(IntFSTTest, Lookup) {
+  const IntFST<TypeParam> fst(this->keys, this->values);
+  ASSERT_EQ(this->keys.size(), fst.getNumKeys());
+  this->checkLookups(fst);
+}
+
+TYPED_TEST(IntFSTTest, LookupSparseOnly) {
+  const IntFST<TypeParam> fst(this->keys, this->values, false, kSparseDenseRatio);
+  ASSERT_EQ(0u, fst.getFST().getSparseStartLevel());
+  this->checkLookups(fst);
+}
+
+TYPED_TEST(IntFSTTest, Iterate) {
+  const IntFST<TypeParam> fst(this->keys, this->values);
+  uint64_t i = 0;
+  for (auto iter = fst.moveToFirst(); iter.isValid(); iter++, i++) {
+    ASSERT_EQ(this->keys[i], IntFST<TypeParam>::getKey(iter));
+    ASSERT_EQ(this->values[i], iter.getValue());
+  }
+  ASSERT_EQ(this->keys.size(), i);
+
+  for (i = 0; i + 1 < this->keys.size(); i += 101) {
+    auto iter = fst.moveToKeyGreaterThan(this->keys[i], false);
+    ASSERT_TRUE(iter.isValid());
+    ASSERT_EQ(this->keys[i + 1], IntFST<TypeParam>::getKey(iter));
+    iter--;
+    ASSERT_TRUE(iter.isValid());
+    ASSERT_EQ(this->keys[i], IntFST<TypeParam>::getKey(iter));
+  }
+  ASSERT_EQ(this->keys.back(), IntFST<TypeParam>::getKey(fst.moveToLast()));
+}
+
+TYPED_TEST(IntFSTTest, Erase) {
+  IntFST<TypeParam> fst(this->keys, this->values);
+  for (uint64_t i = 0; i < this->keys.size(); i += 3) ASSERT_TRUE(fst.erase(this->keys[i]));
+  for (uint64_t i = 0; i < this->keys.size(); i++) {
+    uint64_t value = 0;
+    ASSERT_EQ(i % 3 != 0, fst.lookupKey(this->keys[i], value)) << i;
+  }
+}
+
+TYPED_TEST(IntFSTTest, LookupSorted) {
+  for (const bool include_dense : {true, false}) {
+    IntFST<TypeParam> fst(this->keys, this->values, include_dense, kSparseDenseRatio);
+    for (uint64_t i = 0; i < this->keys.size(); i += 5) fst.erase(this->keys[i]);
+
+    // hits, misses next to them and duplicates of both
+    std::vector<TypeParam> probes;
+    for (uint64_t i = 0; i < this->keys.size(); i++) {
+      probes.emplace_back(this->keys[i]);
+      probes.emplace_back(this->keys[i] + 1);
+      if (i % 7 == 0) {
+        probes.emplace_back(this->keys[i]);
+        probes.emplace_back(this->keys[i] + 1);
+      }
+    }
+    std::sort(probes.begin(), probes.end());
+    for (const bool shuffle : {false, true}) {
+      // unsorted probes are found as well
+      if (shuffle) std::shuffle(probes.begin(), probes.end(), std::mt19937_64(3));
+      std::vector<uint64_t> values(probes.size());
+      std::unique_ptr<bool[]> found(new bool[probes.size()]);
+      fst.lookupSorted(probes.data(), probes.size(), values.data(), found.get());
+      for (uint64_t i = 0; i < probes.size(); i++) {
+        uint64_t value = 0;
+        ASSERT_EQ(fst.lookupKey(probes[i], value), found[i]) << i;
+        if (found[i]) {
+          ASSERT_EQ(value, values[i]);
+        }
+      }
+    }
+  }
+}
+
+TEST(FSTLookupSortedTest, Uint64Keys) {
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 100000; i++) keys.emplace_back(i * i);
+  const FST fst(keys, std::vector<uint64_t>(keys.begin(), keys.end()));
+  std::vector<uint64_t> probes;
+  for (uint64_t i = 0; i < 400000; i++) probes.emplace_back(i);
+  std::vector<uint64_t> values(probes.size());
+  std::unique_ptr<bool[]> found(new bool[probes.size()]);
+  fst.lookupSorted(probes.data(), probes.size(), values.data(), found.get());
+  uint64_t next_square = 0;
+  for (uint64_t i = 0; i < probes.size(); i++) {
+    ASSERT_EQ(i == next_square * next_square, found[i]) << i;
+    if (found[i]) {
+      ASSERT_EQ(i, values[i]);
+      next_square++;
+    }
+  }
+}
+
+} // namespace surftest
+
+} // namespace fst
+
+int main(int argc, char *argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "config.hpp"
+#include "label_vector.hpp"
+
+namespace fst {
+
+namespace surftest {
+
+class LabelVectorTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    // sorted nodes of all sizes, one node per level
+    std::mt19937 gen(5);
+    for (unsigned size = 1; size <= 256; size++) {
+      std::vector<label_t> all_labels(256);
+      for (unsigned i = 0; i < 256; i++) all_labels[i] = i;
+      std::shuffle(all_labels.begin(), all_labels.end(), gen);
+      std::vector<label_t> node(all_labels.begin(), all_labels.begin() + size);
+      std::sort(node.begin(), node.end());
+      nodes.emplace_back(node);
+    }
+  }
+
+  void TearDown() override {}
+
+  std::vector<std::vector<label_t>> nodes;
+};
+
+TEST_F (LabelVectorTest, SearchTest) {
+  LabelVector labels(nodes);
+  position_t start = 0;
+  for (const auto &node : nodes) {
+    const position_t size = node.size();
+    for (unsigned target = 0; target < 256; target++) {
+      auto it = std::find(node.begin(), node.end(), target);
+      position_t pos = start;
+      // a leading 255 is skipped as terminator
+      if (it != node.end() && !(size > 1 && it == node.begin() && target == kTerminator)) {
+        ASSERT_TRUE(labels.search(target, pos, size));
+        ASSERT_EQ(start + (it - node.begin()), pos);
+      } else {
+        ASSERT_FALSE(labels.search(target, pos, size));
+      }
+
+      auto upper = std::upper_bound(node.begin(), node.end(), target);
+      pos = start;
+      if (upper != node.end()) {
+        ASSERT_TRUE(labels.searchGreaterThan(target, pos, size));
+        ASSERT_EQ(start + (upper - node.begin()), pos);
+      } else {
+        ASSERT_FALSE(labels.searchGreaterThan(target, pos, size));
+      }
+    }
+    start += size;
+  }
+}
+
+TEST_F (LabelVectorTest, KernelsTest) {
+  __builtin_cpu_init();
+  const bool has_avx2 = __builtin_cpu_supports("avx2");
+  const bool has_avx512 = __builtin_cpu_supports("avx512bw");
+  std::mt19937 gen(9);
+  for (const auto &node : nodes) {
+    const position_t size = node.size();
+    // matches in the padding must be ignored
+    std::vector<label_t> data(node);
+    for (position_t i = 0; i < kLabelPadding; i++) data.push_back(gen());
+    for (unsigned target = 0; target < 256; target++) {
+      const position_t equal = std::find(node.begin(), node.end(), target) - node.begin();
+      ASSERT_EQ(equal, findEqualSse2(data.data(), target, size));
+      if (has_avx2) {
+        ASSERT_EQ(equal, findEqualAvx2(data.data(), target, size));
+      }
+      if (has_avx512) {
+        ASSERT_EQ(equal, findEqualAvx512(data.data(), target, size));
+      }
+      if (target == 255) continue;
+      const position_t greater = std::upper_bound(node.begin(), node.end(), target) - node.begin();
+      ASSERT_EQ(greater, findGreaterSse2(data.data(), target, size));
+      if (has_avx2) {
+        ASSERT_EQ(greater, findGreaterAvx2(data.data(), target, size));
+      }
+      if (has_avx512) {
+        ASSERT_EQ(greater, findGreaterAvx512(data.data(), target, size));
+      }
+    }
+  }
+}
+
+} // namespace surftest
+
+} // namespace fst
+
+int main(int argc, char *argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
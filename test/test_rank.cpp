@@ -0,0 +1,110 @@
+#include "gtest/gtest.h"
+#include <random>
+#include <vector>
+#include "config.hpp"
+#include "rank.hpp"
+#include "rank_interleaved.hpp"
+
+namespace fst {
+
+namespace surftest {
+
+static const position_t kRankBasicBlockSize = 512;
+
+class RankTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    std::mt19937_64 gen(7);
+    // levels of different sizes and densities, not word aligned
+    for (position_t num_bits : {1u, 63u, 64u, 448u, 449u, 5000u, 100000u}) {
+      std::vector<word_t> bits(num_bits / kWordSize + 1, 0);
+      const unsigned density = gen() % 4;
+      for (auto &word : bits) {
+        word = gen();
+        for (unsigned i = 0; i < density; i++) word &= gen();
+      }
+      // clear the bits after the end of the level
+      if (num_bits % kWordSize != 0)
+        bits[num_bits / kWordSize] &= kOneMask << (kWordSize - num_bits % kWordSize);
+      else
+        bits[num_bits / kWordSize] = 0;
+      bits_per_level.emplace_back(bits);
+      num_bits_per_level.emplace_back(num_bits);
+    }
+  }
+
+  void TearDown() override {}
+
+  std::vector<std::vector<word_t>> bits_per_level;
+  std::vector<position_t> num_bits_per_level;
+};
+
+TEST_F (RankTest, InterleavedRankTest) {
+  BitvectorRank expected(kRankBasicBlockSize, bits_per_level, num_bits_per_level);
+  BitvectorRankInterleaved actual(kRankBasicBlockSize, bits_per_level, num_bits_per_level);
+
+  ASSERT_EQ(expected.numBits(), actual.numBits());
+  for (position_t pos = 0; pos < expected.numBits(); pos++) {
+    ASSERT_EQ(expected.readBit(pos), actual.readBit(pos));
+    ASSERT_EQ(expected.rank(pos), actual.rank(pos));
+    ASSERT_EQ(expected.distanceToNextSetBit(pos), actual.distanceToNextSetBit(pos));
+    ASSERT_EQ(expected.distanceToPrevSetBit(pos), actual.distanceToPrevSetBit(pos));
+  }
+  for (position_t node = 0; node < expected.numBits() / kFanout; node++) {
+    unsigned expected_label = 0;
+    unsigned actual_label = 0;
+    ASSERT_EQ(expected.getNumSetBitsInDenseNode(node, expected_label),
+              actual.getNumSetBitsInDenseNode(node, actual_label));
+    ASSERT_EQ(expected_label, actual_label);
+  }
+}
+
+TEST_F (RankTest, InterleavedRankSerializeTest) {
+  BitvectorRankInterleaved bv(kRankBasicBlockSize, bits_per_level, num_bits_per_level);
+  std::unique_ptr<char[]> data(new char[bv.serializedSize()]());
+  char *dst = data.get();
+  bv.serialize(dst);
+  ASSERT_EQ(bv.serializedSize(), (position_t) (dst - data.get()));
+
+  char *src = data.get();
+  auto deserialized = BitvectorRankInterleaved::deSerialize(src);
+  ASSERT_EQ(bv.serializedSize(), (position_t) (src - data.get()));
+  ASSERT_EQ(bv.numBits(), deserialized->numBits());
+  for (position_t pos = 0; pos < bv.numBits(); pos++) {
+    ASSERT_EQ(bv.readBit(pos), deserialized->readBit(pos));
+    ASSERT_EQ(bv.rank(pos), deserialized->rank(pos));
+  }
+}
+
+TEST_F (RankTest, InterleavedRankAlignmentTest) {
+  BitvectorRankInterleaved bv(kRankBasicBlockSize, bits_per_level, num_bits_per_level);
+  const position_t size = bv.serializedSize();
+  std::unique_ptr<char[]> data(new char[size + 128]());
+  char *line = data.get() + (-reinterpret_cast<uintptr_t>(data.get()) % 64);
+  for (position_t offset = 0; offset < 64; offset += 8) {
+    char *dst = line + offset;
+    bv.serialize(dst);
+    ASSERT_EQ(size, (position_t) (dst - line - offset));
+    char *src = line + offset;
+    auto deserialized = BitvectorRankInterleaved::deSerialize(src);
+    ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(deserialized->lines()) % 64);
+
+    // a copy that is aligned differently is still read correctly
+    std::unique_ptr<char[]> copy(new char[size + 8]);
+    memcpy(copy.get() + 8, line + offset, size);
+    src = copy.get() + 8;
+    deserialized = BitvectorRankInterleaved::deSerialize(src);
+    ASSERT_EQ(size, (position_t) (src - copy.get() - 8));
+    for (position_t pos = 0; pos < bv.numBits(); pos += 7)
+      ASSERT_EQ(bv.rank(pos), deserialized->rank(pos));
+  }
+}
+
+} // namespace surftest
+
+} // namespace fst
+
+int main(int argc, char *argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,112 @@
+#include "gtest/gtest.h"
+#include <random>
+#include <vector>
+#include "config.hpp"
+#include "select.hpp"
+
+namespace fst {
+
+namespace surftest {
+
+static const position_t kSelectSampleInterval = 64;
+
+class SelectTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    std::mt19937_64 gen(11);
+    // levels of different sizes and densities, each starting with a 1 bit
+    for (position_t num_bits : {1u, 64u, 513u, 5000u, 100000u, 300000u}) {
+      std::vector<word_t> bits(num_bits / kWordSize + 1, 0);
+      const unsigned density = gen() % 8;
+      for (auto &word : bits) {
+        word = gen();
+        for (unsigned i = 0; i < density; i++) word &= gen();
+      }
+      bits[0] |= kMsbMask;
+      if (num_bits % kWordSize != 0)
+        bits[num_bits / kWordSize] &= kOneMask << (kWordSize - num_bits % kWordSize);
+      else
+        bits[num_bits / kWordSize] = 0;
+      bits_per_level.emplace_back(bits);
+      num_bits_per_level.emplace_back(num_bits);
+    }
+  }
+
+  void TearDown() override {}
+
+  std::vector<std::vector<word_t>> bits_per_level;
+  std::vector<position_t> num_bits_per_level;
+};
+
+TEST_F (SelectTest, SelectInWordTest) {
+  std::mt19937_64 gen(3);
+  for (int i = 0; i < 10000; i++) {
+    word_t word = gen() & gen();
+    if (word == 0) continue;
+    position_t rank = 0;
+    for (position_t pos = 0; pos < kWordSize; pos++) {
+      if (!(word & (kMsbMask >> pos))) continue;
+      rank++;
+      ASSERT_EQ(pos, selectInWord(word, rank));
+      ASSERT_EQ(pos, (position_t) select64_popcount_search(word, rank));
+    }
+  }
+}
+
+TEST_F (SelectTest, SelectTest) {
+  BitvectorSelect bv(kSelectSampleInterval, bits_per_level, num_bits_per_level);
+  position_t rank = 0;
+  for (position_t pos = 0; pos < bv.numBits(); pos++) {
+    if (!bv.readBit(pos)) continue;
+    rank++;
+    ASSERT_EQ(pos, bv.select(rank));
+  }
+  ASSERT_EQ(rank, bv.numOnes());
+
+  std::unique_ptr<char[]> data(new char[bv.serializedSize()]());
+  char *dst = data.get();
+  bv.serialize(dst);
+  ASSERT_EQ(bv.serializedSize(), (position_t) (dst - data.get()));
+  char *src = data.get();
+  auto deserialized = BitvectorSelect::deSerialize(src);
+  ASSERT_EQ(bv.serializedSize(), (position_t) (src - data.get()));
+  for (rank = 1; rank <= bv.numOnes(); rank++)
+    ASSERT_EQ(bv.select(rank), deserialized->select(rank));
+}
+
+TEST_F (SelectTest, SparseSelectTest) {
+  // many blocks without a 1 bit between two select samples
+  std::mt19937_64 gen(5);
+  const position_t num_bits = 2000000;
+  std::vector<word_t> bits(num_bits / kWordSize + 1, 0);
+  std::vector<position_t> positions;
+  for (position_t pos = 0; pos < num_bits; pos += 1 + gen() % 3000) {
+    bits[pos / kWordSize] |= kMsbMask >> (pos % kWordSize);
+    positions.emplace_back(pos);
+  }
+  BitvectorSelect bv(kSelectSampleInterval, {bits}, {num_bits});
+  ASSERT_EQ(positions.size(), bv.numOnes());
+  for (position_t rank = 1; rank <= bv.numOnes(); rank++)
+    ASSERT_EQ(positions[rank - 1], bv.select(rank));
+}
+
+TEST_F (SelectTest, WordBoundaryTest) {
+  // the second level ends exactly on a word boundary
+  std::vector<std::vector<word_t>> bits = {{0xF0F0F0F000000000}, {0xFFFF000000000000}};
+  BitvectorSelect bv(kSelectSampleInterval, bits, {32, 32});
+  ASSERT_EQ(64u, bv.numBits());
+  ASSERT_EQ(1u, bv.numWords());
+  ASSERT_EQ(32u, bv.numOnes());
+  ASSERT_EQ(0u, bv.select(1));
+  ASSERT_EQ(32u, bv.select(17));
+  ASSERT_EQ(47u, bv.select(32));
+}
+
+} // namespace surftest
+
+} // namespace fst
+
+int main(int argc, char *argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
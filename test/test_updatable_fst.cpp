@@ -0,0 +1,161 @@
+#include "gtest/gtest.h"
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config.hpp"
+#include "updatable_fst.hpp"
+
+namespace fst {
+
+namespace surftest {
+
+static const uint64_t kNumKeys = 20000;
+
+// keys of equal length, so that none is a prefix of another
+std::string makeKey(uint64_t i) {
+  char key[16];
+  snprintf(key, sizeof(key), "key%08lu", (unsigned long) i);
+  return key;
+}
+
+class UpdatableFSTTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    // the even keys are stored in the initial FST
+    for (uint64_t i = 0; i < kNumKeys; i += 2) {
+      keys.emplace_back(makeKey(i));
+      values.emplace_back(i);
+      model[makeKey(i)] = i;
+    }
+  }
+
+  // inserts the odd keys, erases every third key and updates every fifth
+  void update(UpdatableFST &fst) {
+    for (uint64_t i = 0; i < kNumKeys; i++) {
+      if (i % 2 == 1) {
+        fst.insert(makeKey(i), i);
+        model[makeKey(i)] = i;
+      }
+      if (i % 3 == 0) {
+        fst.erase(makeKey(i));
+        model.erase(makeKey(i));
+      } else if (i % 5 == 0) {
+        fst.insert(makeKey(i), i + kNumKeys);
+        model[makeKey(i)] = i + kNumKeys;
+      }
+    }
+  }
+
+  void check(const UpdatableFST &fst) {
+    for (uint64_t i = 0; i < kNumKeys + 10; i++) {
+      uint64_t value = 0;
+      auto entry = model.find(makeKey(i));
+      ASSERT_EQ(entry != model.end(), fst.lookupKey(makeKey(i), value)) << i;
+      if (entry != model.end()) {
+        ASSERT_EQ(entry->second, value);
+      }
+    }
+
+    auto entry = model.begin();
+    for (auto iter = fst.moveToFirst(); iter.isValid(); iter++, entry++) {
+      ASSERT_NE(model.end(), entry);
+      ASSERT_EQ(entry->first, iter.getKey());
+      ASSERT_EQ(entry->second, iter.getValue());
+    }
+    ASSERT_EQ(model.end(), entry);
+
+    for (uint64_t i = 0; i < kNumKeys; i += 97) {
+      for (const bool inclusive : {true, false}) {
+        auto iter = fst.moveToKeyGreaterThan(makeKey(i), inclusive);
+        auto expected = inclusive ? model.lower_bound(makeKey(i)) : model.upper_bound(makeKey(i));
+        for (int step = 0; step < 5 && expected != model.end(); step++, iter++, expected++) {
+          ASSERT_TRUE(iter.isValid());
+          ASSERT_EQ(expected->first, iter.getKey());
+          ASSERT_EQ(expected->second, iter.getValue());
+        }
+      }
+    }
+  }
+
+  std::vector<std::string> keys;
+  std::vector<uint64_t> values;
+  std::map<std::string, uint64_t> model;
+};
+
+TEST_F (UpdatableFSTTest, DeltaOnly) {
+  // no rebuild: all writes stay in the delta
+  UpdatableFST fst(keys, values, kNumKeys * 2);
+  update(fst);
+  check(fst);
+
+  fst.rebuild();
+  // the frozen delta is merged while the rebuild runs
+  check(fst);
+  fst.waitForRebuild();
+  check(fst);
+}
+
+TEST_F (UpdatableFSTTest, BackgroundRebuilds) {
+  // frequent rebuilds that overlap with the writes
+  UpdatableFST fst(keys, values, 500);
+  update(fst);
+  check(fst);
+  fst.waitForRebuild();
+  check(fst);
+  fst.rebuild();
+  fst.waitForRebuild();
+  check(fst);
+}
+
+TEST_F (UpdatableFSTTest, EmptyFST) {
+  UpdatableFST fst({}, {}, 100);
+  ASSERT_FALSE(fst.moveToFirst().isValid());
+  model.clear();
+  update(fst);
+  fst.waitForRebuild();
+  check(fst);
+
+  // erase everything
+  for (uint64_t i = 0; i < kNumKeys; i++) fst.erase(makeKey(i));
+  fst.rebuild();
+  fst.waitForRebuild();
+  model.clear();
+  check(fst);
+}
+
+TEST_F (UpdatableFSTTest, ConcurrentReaders) {
+  UpdatableFST fst(keys, values, 300);
+  std::atomic<bool> done(false);
+  std::atomic<uint64_t> errors(0);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; t++) {
+    readers.emplace_back([&, t]() {
+      // the keys that are a multiple of 4 but not of 3 or 5 never change
+      for (uint64_t i = t; !done; i = (i + 7) % kNumKeys) {
+        if (i % 4 != 0 || i % 3 == 0 || i % 5 == 0) continue;
+        uint64_t value = 0;
+        if (!fst.lookupKey(makeKey(i), value) || value != i) errors++;
+        auto iter = fst.moveToKeyGreaterThan(makeKey(i), true);
+        if (!iter.isValid() || iter.getKey() != makeKey(i)) errors++;
+      }
+    });
+  }
+  update(fst);
+  done = true;
+  for (auto &reader : readers) reader.join();
+  ASSERT_EQ(0u, errors.load());
+  fst.waitForRebuild();
+  check(fst);
+}
+
+} // namespace surftest
+
+} // namespace fst
+
+int main(int argc, char *argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,87 @@
+#include "gtest/gtest.h"
+#include <random>
+#include <vector>
+#include "config.hpp"
+#include "value_vector.hpp"
+
+namespace fst {
+
+namespace surftest {
+
+static const uint64_t kNumValues = 10000;
+
+class ValueVectorTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    std::mt19937_64 gen(42);
+    for (uint64_t i = 0; i < kNumValues; i++) {
+      monotone_values.emplace_back(1000000 + 3 * i + gen() % 3);
+      random_values.emplace_back(gen() >> (gen() % 64));
+    }
+    // level-ordered leaves of a trie: monotone runs with jumps in between
+    for (uint64_t i = 0; i < kNumValues; i++)
+      leaf_values.emplace_back((i * 7919) % kNumValues);
+  }
+
+  static void assertEqualValues(const std::vector<uint64_t> &expected,
+                                const ValueVector &actual) {
+    ASSERT_EQ(expected.size(), actual.numValues());
+    for (position_t pos = 0; pos < expected.size(); pos++)
+      ASSERT_EQ(expected[pos], actual.read(pos));
+  }
+
+  std::vector<uint64_t> monotone_values;
+  std::vector<uint64_t> random_values;
+  std::vector<uint64_t> leaf_values;
+};
+
+TEST_F (ValueVectorTest, EncodingsTest) {
+  std::vector<uint64_t> zeros(kNumValues, 0);
+  std::vector<uint64_t> extremes = {0, UINT64_MAX, 1, UINT64_MAX - 1, 0};
+  for (auto encoding : {ValueEncoding::kPlain, ValueEncoding::kBitPacked,
+                        ValueEncoding::kFrameOfReference, ValueEncoding::kAuto}) {
+    for (const auto *values : {&monotone_values, &random_values, &leaf_values,
+                               &zeros, &extremes}) {
+      ValueVector vv(*values, encoding);
+      assertEqualValues(*values, vv);
+    }
+  }
+}
+
+TEST_F (ValueVectorTest, AutoEncodingTest) {
+  ValueVector monotone(monotone_values);
+  ASSERT_EQ(ValueEncoding::kFrameOfReference, monotone.getEncoding());
+  ASSERT_LT(monotone.valuesSize(), kNumValues * sizeof(uint64_t) / 4);
+
+  ValueVector leaves(leaf_values);
+  ASSERT_EQ(ValueEncoding::kBitPacked, leaves.getEncoding());
+
+  ValueVector plain(std::vector<uint64_t>{UINT64_MAX});
+  ASSERT_EQ(ValueEncoding::kPlain, plain.getEncoding());
+}
+
+TEST_F (ValueVectorTest, SerializeTest) {
+  for (auto encoding : {ValueEncoding::kPlain, ValueEncoding::kBitPacked,
+                        ValueEncoding::kFrameOfReference}) {
+    ValueVector vv(monotone_values, encoding);
+    std::unique_ptr<char[]> data(new char[vv.serializedSize()]());
+    char *dst = data.get();
+    vv.serialize(dst);
+    ASSERT_EQ(vv.serializedSize(), (uint64_t) (dst - data.get()));
+
+    char *src = data.get();
+    auto deserialized = ValueVector::deSerialize(src);
+    ASSERT_EQ(vv.serializedSize(), (uint64_t) (src - data.get()));
+    ASSERT_EQ(encoding, deserialized->getEncoding());
+    assertEqualValues(monotone_values, *deserialized);
+  }
+}
+
+} // namespace surftest
+
+} // namespace fst
+
+int main(int argc, char *argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}